@@ -0,0 +1,80 @@
+// Copyright (C) 2026 Signal Slot Inc.
+// SPDX-License-Identifier: MIT
+//
+// Cold-start benchmark: opens the app in a fresh browser context (empty
+// HTTP/Cache Storage) for every run, loads each PSD of the corpus and
+// records the loader + module phase timings up to the first composite.
+//
+// Usage:
+//   npm run build && npx vite preview &
+//   node bench/cold-start.mjs [--url http://localhost:4173] [--runs 3] [file.psd ...]
+//
+// Without file arguments every *.psd in bench/corpus is used (generate it
+// with: psdgen --all-presets bench/corpus). Results are
+// printed as one JSON object per run (JSON Lines) for trend tracking.
+// Requires puppeteer (npm install --no-save puppeteer).
+
+import { readdir, readFile } from 'node:fs/promises';
+import { basename, dirname, join } from 'node:path';
+import { fileURLToPath } from 'node:url';
+
+const args = process.argv.slice(2);
+let url = 'http://localhost:4173';
+let runs = 3;
+const files = [];
+for (let i = 0; i < args.length; i++) {
+  if (args[i] === '--url') url = args[++i];
+  else if (args[i] === '--runs') runs = Number(args[++i]);
+  else files.push(args[i]);
+}
+
+if (files.length === 0) {
+  const corpusDir = join(dirname(fileURLToPath(import.meta.url)), 'corpus');
+  const entries = await readdir(corpusDir).catch(() => []);
+  for (const entry of entries.sort()) {
+    if (entry.endsWith('.psd')) files.push(join(corpusDir, entry));
+  }
+}
+if (files.length === 0) {
+  console.error('No PSD files given and bench/corpus is empty');
+  process.exit(1);
+}
+
+let puppeteer;
+try {
+  puppeteer = (await import('puppeteer')).default;
+} catch {
+  console.error('puppeteer is required: npm install --no-save puppeteer');
+  process.exit(1);
+}
+
+const browser = await puppeteer.launch({ headless: true });
+try {
+  for (const file of files) {
+    const base64 = (await readFile(file)).toString('base64');
+    for (let run = 0; run < runs; run++) {
+      const context = await (browser.createBrowserContext?.() ?? browser.createIncognitoBrowserContext());
+      const page = await context.newPage();
+      const navigationStart = Date.now();
+      await page.goto(`${url}/?bench`, { waitUntil: 'load' });
+      await page.waitForFunction(() => '__psdRunBench' in window);
+
+      const timings = await page.evaluate(async (data, name) => {
+        const bytes = Uint8Array.from(atob(data), c => c.charCodeAt(0));
+        const bench = window.__psdRunBench;
+        await bench.loadPsd(bytes, name);
+        return bench.timings();
+      }, base64, basename(file));
+
+      console.log(JSON.stringify({
+        file: basename(file),
+        run,
+        wallMs: Date.now() - navigationStart,
+        timings,
+      }));
+      await context.close();
+    }
+  }
+} finally {
+  await browser.close();
+}
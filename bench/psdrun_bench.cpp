@@ -0,0 +1,256 @@
+// Copyright (C) 2026 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+//
+// Native benchmarks for the document core (psdrun_core): parse throughput,
+// full scene composite, applyMasks cost per megapixel, folder composite as
+// used by getLayerImage, layer JSON export, hint round-trips and text
+// edits with a re-render, for every PSD in the corpus directory.
+//
+// Usage:
+//   psdrun_bench [--corpus DIR] [Google Benchmark flags]
+//
+// For trend tracking write machine-readable results with
+//   --benchmark_out=psdrun_bench.json --benchmark_out_format=json
+// (the psdrun_bench_run target does this, after generating the psdgen
+// preset corpus). Without --corpus, the PSDRUN_BENCH_CORPUS environment
+// variable or the configured corpus directory is used.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+#include <QtWidgets/QApplication>
+
+#include <QtPsdGui/QPsdAbstractLayerItem>
+
+#include "psdrun_core.h"
+
+#ifndef PSDRUN_BENCH_CORPUS_DIR
+#define PSDRUN_BENCH_CORPUS_DIR "bench/corpus"
+#endif
+
+namespace {
+
+struct CorpusFile {
+    QString path;
+    std::string name;
+    qint64 size = 0;
+    PsdData* document = nullptr;  // loaded once, shared by all but the parse benchmark
+};
+
+template <typename Visit>
+void forEachLayer(const QPsdExporterTreeItemModel* model, const QModelIndex& parent, Visit visit) {
+    for (int row = 0; row < model->rowCount(parent); ++row) {
+        const QModelIndex index = model->index(row, 0, parent);
+        visit(index, model->layerItem(index));
+        forEachLayer(model, index, visit);
+    }
+}
+
+void benchParse(benchmark::State& state, const CorpusFile* file) {
+    for (auto _ : state) {
+        std::string error;
+        PsdData* psdData = loadPsdFile(file->path, error);
+        if (!psdData) {
+            state.SkipWithError(error.c_str());
+            return;
+        }
+        benchmark::DoNotOptimize(psdData);
+        delete psdData;
+    }
+    state.SetBytesProcessed(state.iterations() * file->size);
+}
+
+void benchComposite(benchmark::State& state, const CorpusFile* file) {
+    PsdData* psdData = file->document;
+    const std::set<int> none;
+    for (auto _ : state) {
+        QImage image = renderScene(psdData, none, none);
+        benchmark::DoNotOptimize(image.constBits());
+    }
+    state.counters["pixels"] = benchmark::Counter(
+        double(psdData->width) * psdData->height, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void benchApplyMasks(benchmark::State& state, const CorpusFile* file) {
+    const auto* model = file->document->exporterModel.get();
+    std::vector<const QPsdAbstractLayerItem*> items;
+    double megapixels = 0;
+    forEachLayer(model, QModelIndex(), [&](const QModelIndex&, const QPsdAbstractLayerItem* item) {
+        if (!item || item->type() == QPsdAbstractLayerItem::Folder) return;
+        if (item->layerMask().isNull() && item->transparencyMask().isNull()) return;
+        items.push_back(item);
+        megapixels += double(item->rect().width()) * item->rect().height() / 1e6;
+    });
+    if (items.empty()) {
+        state.SkipWithError("no masked layers");
+        return;
+    }
+
+    for (auto _ : state) {
+        for (const auto* item : items) {
+            QImage image = applyMasks(item);
+            benchmark::DoNotOptimize(image.constBits());
+        }
+    }
+    // Seconds per megapixel of masked layer content
+    state.counters["s/MP"] = benchmark::Counter(megapixels,
+        benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+    state.counters["layers"] = double(items.size());
+}
+
+void benchFolderComposite(benchmark::State& state, const CorpusFile* file) {
+    PsdData* psdData = file->document;
+    const auto* model = psdData->exporterModel.get();
+    std::vector<QModelIndex> folders;
+    for (int row = 0; row < model->rowCount(); ++row) {
+        const QModelIndex index = model->index(row, 0);
+        const auto* item = model->layerItem(index);
+        if (item && item->type() == QPsdAbstractLayerItem::Folder)
+            folders.push_back(index);
+    }
+    if (folders.empty()) {
+        state.SkipWithError("no top-level folders");
+        return;
+    }
+
+    double pixels = 0;
+    for (auto _ : state) {
+        pixels = 0;
+        for (const auto& index : folders) {
+            QRect bounds;
+            QImage image = compositeFolder(psdData, index, bounds);
+            benchmark::DoNotOptimize(image.constBits());
+            pixels += double(bounds.width()) * bounds.height();
+        }
+    }
+    state.counters["pixels"] = benchmark::Counter(pixels, benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["folders"] = double(folders.size());
+}
+
+void benchExportJson(benchmark::State& state, const CorpusFile* file) {
+    QByteArray out;
+    for (auto _ : state) {
+        writeDocumentJson(file->document, out, -1, -1, JsonAllFields);
+        benchmark::DoNotOptimize(out.constData());
+    }
+    state.SetBytesProcessed(state.iterations() * out.size());
+}
+
+void benchHintsRoundTrip(benchmark::State& state, const CorpusFile* file) {
+    for (auto _ : state) {
+        const QByteArray json = hintsToJson(file->document);
+        benchmark::DoNotOptimize(hintsFromJson(file->document, json));
+    }
+}
+
+// Set every text layer, then composite once; runs last on each document
+// (benchmarks are registered by name), as it leaves the new texts in place
+void benchTextUpdate(benchmark::State& state, const CorpusFile* file) {
+    PsdData* psdData = file->document;
+    std::vector<int> ids;
+    forEachLayer(psdData->exporterModel.get(), QModelIndex(),
+                 [&](const QModelIndex&, const QPsdAbstractLayerItem* item) {
+        if (item && item->type() == QPsdAbstractLayerItem::Text)
+            ids.push_back(int(item->id()));
+    });
+    if (ids.empty()) {
+        state.SkipWithError("no text layers");
+        return;
+    }
+
+    const std::set<int> none;
+    qint64 round = 0;
+    for (auto _ : state) {
+        const QString text = QStringLiteral("Value %1").arg(++round);
+        std::string error;
+        for (int id : ids) {
+            if (!setTextLayerText(psdData, id, text, error)) {
+                state.SkipWithError(error.c_str());
+                return;
+            }
+        }
+        QImage image = renderScene(psdData, none, none);
+        benchmark::DoNotOptimize(image.constBits());
+    }
+    state.counters["layers"] = double(ids.size());
+}
+
+QString corpusDirectory(int& argc, char** argv) {
+    QString dir = qEnvironmentVariable("PSDRUN_BENCH_CORPUS", QStringLiteral(PSDRUN_BENCH_CORPUS_DIR));
+    // Consume --corpus before Google Benchmark sees the arguments
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--corpus") == 0 && i + 1 < argc) {
+            dir = QString::fromLocal8Bit(argv[i + 1]);
+            std::memmove(argv + i, argv + i + 2, sizeof(char*) * (argc - i - 1));
+            argc -= 2;
+            break;
+        }
+    }
+    return dir;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    const QString corpusDir = corpusDirectory(argc, argv);
+    QApplication app(argc, argv);
+
+    const QFileInfoList entries = QDir(corpusDir).entryInfoList(
+        { QStringLiteral("*.psd") }, QDir::Files, QDir::Name);
+    if (entries.isEmpty()) {
+        std::fprintf(stderr, "No PSD files in %s\n", qPrintable(corpusDir));
+        return 1;
+    }
+
+    std::vector<CorpusFile> corpus(entries.size());
+    for (qsizetype i = 0; i < entries.size(); ++i) {
+        CorpusFile& file = corpus[i];
+        file.path = entries[i].absoluteFilePath();
+        file.name = entries[i].completeBaseName().toStdString();
+        file.size = entries[i].size();
+
+        std::string error;
+        file.document = loadPsdFile(file.path, error);
+        if (!file.document) {
+            std::fprintf(stderr, "%s: %s\n", qPrintable(file.path), error.c_str());
+            return 1;
+        }
+    }
+
+    static const std::map<std::string, void (*)(benchmark::State&, const CorpusFile*)> benchmarks = {
+        { "parse", benchParse },
+        { "composite", benchComposite },
+        { "applyMasks", benchApplyMasks },
+        { "folderComposite", benchFolderComposite },
+        { "exportLayerJson", benchExportJson },
+        { "hintsRoundTrip", benchHintsRoundTrip },
+        { "textUpdate", benchTextUpdate },
+    };
+    for (const auto& file : corpus) {
+        for (const auto& [name, function] : benchmarks) {
+            benchmark::RegisterBenchmark((name + "/" + file.name).c_str(), function, &file)
+                ->Unit(benchmark::kMillisecond);
+        }
+    }
+
+    benchmark::AddCustomContext("corpus", corpusDir.toStdString());
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    for (auto& file : corpus)
+        delete file.document;
+    return 0;
+}
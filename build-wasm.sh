@@ -4,9 +4,31 @@ set -e
 # Build PSD Run WASM module using Qt for WebAssembly
 
 SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
-BUILD_DIR="${SCRIPT_DIR}/.target/wasm"
 OUTPUT_DIR="${SCRIPT_DIR}/public/wasm"
 
+# Module variant: "full" (default) or "lite" (no adjustment layer plugins,
+# optimized for size; loaded only with ?wasm=lite)
+VARIANT="${PSDRUN_VARIANT:-full}"
+case "$VARIANT" in
+    full)
+        VARIANT_ARGS=()
+        OUTPUT_SUFFIX=""
+        ;;
+    lite)
+        VARIANT_ARGS=(-DPSDRUN_WITH_ADJUSTMENT_PLUGINS=OFF -DPSDRUN_OPTIMIZE_SIZE=ON)
+        OUTPUT_SUFFIX="-lite"
+        ;;
+    *)
+        echo "Error: unknown PSDRUN_VARIANT '$VARIANT' (expected full or lite)"
+        exit 1
+        ;;
+esac
+BUILD_DIR="${SCRIPT_DIR}/.target/wasm${OUTPUT_SUFFIX}"
+
+# WebAssembly SIMD is required by default; PSDRUN_WASM_SIMD=OFF builds a
+# scalar module for runtimes without it
+VARIANT_ARGS+=(-DPSDRUN_WASM_SIMD="${PSDRUN_WASM_SIMD:-ON}")
+
 # Check for Qt WASM installation
 if [ -z "$QT_WASM_PATH" ]; then
     # Search common locations
@@ -27,6 +49,7 @@ if [ -z "$QT_WASM_PATH" ]; then
 fi
 
 echo "Using Qt WASM at: $QT_WASM_PATH"
+echo "Building module variant: $VARIANT"
 
 # Auto-detect and activate emsdk if emcc is not in PATH
 if ! command -v emcc &> /dev/null; then
@@ -64,6 +87,7 @@ echo "Configuring..."
 "$QT_WASM_PATH/bin/qt-cmake" \
     -DCMAKE_BUILD_TYPE=Release \
     -DCMAKE_PREFIX_PATH="$QT_WASM_PATH" \
+    "${VARIANT_ARGS[@]}" \
     "$SCRIPT_DIR"
 
 echo "Building..."
@@ -72,8 +96,25 @@ cmake --build . --target psdrun_qt --parallel
 mkdir -p "$OUTPUT_DIR"
 
 # Main thread Qt module
-cp psdrun_qt.js "$OUTPUT_DIR/" 2>/dev/null || true
-cp psdrun_qt.wasm "$OUTPUT_DIR/" 2>/dev/null || true
+cp psdrun_qt.js "$OUTPUT_DIR/psdrun_qt${OUTPUT_SUFFIX}.js" 2>/dev/null || true
+cp psdrun_qt.wasm "$OUTPUT_DIR/psdrun_qt${OUTPUT_SUFFIX}.wasm" 2>/dev/null || true
+
+# Content-hashed copies plus a manifest naming them. The hashed files never
+# change, so they can be cached forever (and compiled code reused by the
+# browser); only the small manifest is revalidated on each visit.
+content_hash() {
+    if command -v sha256sum &> /dev/null; then
+        sha256sum "$1" | cut -c1-16
+    else
+        shasum -a 256 "$1" | cut -c1-16
+    fi
+}
+rm -f "$OUTPUT_DIR"/psdrun_qt${OUTPUT_SUFFIX}.*.js "$OUTPUT_DIR"/psdrun_qt${OUTPUT_SUFFIX}.*.wasm
+JS_NAME="psdrun_qt${OUTPUT_SUFFIX}.$(content_hash psdrun_qt.js).js"
+WASM_NAME="psdrun_qt${OUTPUT_SUFFIX}.$(content_hash psdrun_qt.wasm).wasm"
+cp psdrun_qt.js "$OUTPUT_DIR/$JS_NAME"
+cp psdrun_qt.wasm "$OUTPUT_DIR/$WASM_NAME"
+echo "{ \"js\": \"$JS_NAME\", \"wasm\": \"$WASM_NAME\" }" > "$OUTPUT_DIR/psdrun_qt${OUTPUT_SUFFIX}.manifest.json"
 
 echo "Build complete. Output in: $OUTPUT_DIR"
 ls -la "$OUTPUT_DIR"
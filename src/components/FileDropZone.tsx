@@ -3,6 +3,7 @@
 
 import { useCallback, useState, useRef } from 'react';
 import { usePsdStore } from '../stores/psd-store';
+import type { ParseStageName } from '../lib/types';
 
 const styles = {
   container: (isDragging: boolean, hasFile: boolean) => ({
@@ -34,12 +35,22 @@ const styles = {
   },
 };
 
+// The stages take very different times, so name the one running instead
+// of showing a percentage
+const STAGE_LABELS: Record<ParseStageName, string> = {
+  widgetModel: 'Reading layers',
+  scene: 'Building scene',
+  exporterModel: 'Reading export data',
+  done: 'Finishing',
+};
+
 export default function FileDropZone() {
   const [isDragging, setIsDragging] = useState(false);
   const inputRef = useRef<HTMLInputElement>(null);
 
   const psd = usePsdStore(state => state.psd);
   const loading = usePsdStore(state => state.loading);
+  const parseProgress = usePsdStore(state => state.parseProgress);
   const fileName = usePsdStore(state => state.fileName);
   const loadPsd = usePsdStore(state => state.loadPsd);
 
@@ -96,7 +107,15 @@ export default function FileDropZone() {
       <div style={styles.label(!!psd)}>Open PSD</div>
 
       {loading ? (
-        <div style={{ fontSize: '14px' }}>Loading...</div>
+        <div style={{ fontSize: '14px' }}>
+          Loading...
+          {parseProgress && (
+            <span style={{ opacity: 0.6 }}>
+              {' '}{STAGE_LABELS[parseProgress.stageName]}
+              {parseProgress.layers > 0 && ` | ${parseProgress.layers} layers`}
+            </span>
+          )}
+        </div>
       ) : psd ? (
         <>
           <div style={styles.fileName}>{fileName}</div>
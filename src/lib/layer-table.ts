@@ -0,0 +1,130 @@
+// Copyright (C) 2026 Signal Slot Inc.
+// SPDX-License-Identifier: MIT
+//
+// Decoder for the binary layer table produced by parsePsdCompact/getLayerTable
+// (see buildLayerTable() in psdrun_core.cpp for the layout).
+
+import type { BlendMode, ItemType, LayerInfo, LayerType } from './types';
+
+const LAYER_TABLE_MAGIC = 0x4C525350; // "PSRL"
+const LAYER_TABLE_VERSION = 1;
+const HEADER_INTS = 4;
+
+enum Column {
+  Id, Index, X, Y, Width, Height, Flags, Opacity, BlendMode,
+  NameOffset, NameLength, TextOffset, TextLength,
+  Count
+}
+
+// Must match s_blendModes order in psdrun_core.cpp
+const BLEND_MODES: BlendMode[] = [
+  'passThrough', 'normal', 'dissolve',
+  'darken', 'multiply', 'colorBurn', 'linearBurn', 'darkerColor',
+  'lighten', 'screen', 'colorDodge', 'linearDodge', 'lighterColor',
+  'overlay', 'softLight', 'hardLight', 'vividLight', 'linearLight', 'pinLight', 'hardMix',
+  'difference', 'exclusion', 'subtract', 'divide',
+  'hue', 'saturation', 'color', 'luminosity',
+];
+
+const ROW_TYPES: LayerType[] = ['layer', 'group', 'groupEnd'];
+const ITEM_TYPES: ItemType[] = ['unknown', 'text', 'shape', 'image', 'folder'];
+
+const utf8 = new TextDecoder();
+
+export class LayerTable {
+  readonly rowCount: number;
+  private readonly columns: Int32Array;
+  private readonly pool: Uint8Array;
+  private readonly names: (string | undefined)[];
+  private readonly texts: (string | undefined)[];
+
+  // Copies the bytes out of WASM memory, which may move on the next call
+  constructor(view: Uint8Array) {
+    const bytes = view.slice();
+    const header = new Int32Array(bytes.buffer, 0, HEADER_INTS);
+    if (header[0] !== LAYER_TABLE_MAGIC || header[1] !== LAYER_TABLE_VERSION) {
+      throw new Error('Unsupported layer table format');
+    }
+    this.rowCount = header[2];
+    const columnsBytes = Column.Count * this.rowCount * 4;
+    this.columns = new Int32Array(bytes.buffer, HEADER_INTS * 4, Column.Count * this.rowCount);
+    this.pool = new Uint8Array(bytes.buffer, HEADER_INTS * 4 + columnsBytes, header[3]);
+    this.names = new Array(this.rowCount);
+    this.texts = new Array(this.rowCount);
+  }
+
+  int(column: Column, row: number): number {
+    return this.columns[column * this.rowCount + row];
+  }
+
+  id(row: number): number { return this.int(Column.Id, row); }
+  type(row: number): LayerType { return ROW_TYPES[this.int(Column.Flags, row) & 3]; }
+  visible(row: number): boolean { return (this.int(Column.Flags, row) & 4) !== 0; }
+  itemType(row: number): ItemType { return ITEM_TYPES[(this.int(Column.Flags, row) >> 3) & 7] ?? 'unknown'; }
+  blendMode(row: number): BlendMode { return BLEND_MODES[this.int(Column.BlendMode, row)] ?? 'normal'; }
+
+  name(row: number): string {
+    let name = this.names[row];
+    if (name === undefined) {
+      name = this.string(this.int(Column.NameOffset, row), this.int(Column.NameLength, row));
+      this.names[row] = name;
+    }
+    return name;
+  }
+
+  text(row: number): string | undefined {
+    const offset = this.int(Column.TextOffset, row);
+    if (offset < 0) return undefined;
+    let text = this.texts[row];
+    if (text === undefined) {
+      text = this.string(offset, this.int(Column.TextLength, row));
+      this.texts[row] = text;
+    }
+    return text;
+  }
+
+  private string(offset: number, length: number): string {
+    return length > 0 ? utf8.decode(this.pool.subarray(offset, offset + length)) : '';
+  }
+
+  // Materialize LayerInfo objects; numeric fields are copied eagerly, while
+  // name/text are decoded from the string pool on first access.
+  toLayerInfos(): LayerInfo[] {
+    const layers: LayerInfo[] = new Array(this.rowCount);
+    for (let row = 0; row < this.rowCount; row++) {
+      layers[row] = new TableLayerInfo(this, row);
+    }
+    return layers;
+  }
+}
+
+class TableLayerInfo implements LayerInfo {
+  id: number;
+  index: number;
+  x: number;
+  y: number;
+  width: number;
+  height: number;
+  visible: boolean;
+  opacity: number;
+  blendMode: BlendMode;
+  type: LayerType;
+  itemType?: ItemType;
+
+  constructor(private readonly table: LayerTable, private readonly row: number) {
+    this.id = table.id(row);
+    this.index = table.int(Column.Index, row);
+    this.x = table.int(Column.X, row);
+    this.y = table.int(Column.Y, row);
+    this.width = table.int(Column.Width, row);
+    this.height = table.int(Column.Height, row);
+    this.visible = table.visible(row);
+    this.opacity = table.int(Column.Opacity, row);
+    this.blendMode = table.blendMode(row);
+    this.type = table.type(row);
+    if (this.type !== 'groupEnd') this.itemType = table.itemType(row);
+  }
+
+  get name(): string { return this.type === 'groupEnd' ? '' : this.table.name(this.row); }
+  get text(): string | undefined { return this.table.text(this.row); }
+}
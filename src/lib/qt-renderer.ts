@@ -3,7 +3,26 @@
 //
 // Qt Renderer - Main thread WASM module for full Qt rendering with hints support
 
-import type { RenderedImage, LayerInfo } from './types';
+import type {
+  RenderedImage, LayerInfo, LayerJsonOptions, LayerVisibility, MemoryStats, ModuleStats, ParseProgress,
+  ParseStageName, PhaseTiming, StateDeltaResult, TextUpdate, TextUpdateResult
+} from './types';
+import { LayerJsonFields } from './types';
+import { LayerTable } from './layer-table';
+
+// beginParse/continueParse result; handle and size are set after the last stage
+interface ParseStep {
+  parseId?: number;
+  stage?: number;
+  stages?: number;
+  stageName?: ParseStageName;
+  bytes?: number;
+  layers?: number;
+  handle?: number;
+  width?: number;
+  height?: number;
+  error?: string;
+}
 
 interface PsdRunModule {
   allocateBuffer(size: number): void;
@@ -15,12 +34,37 @@ interface PsdRunModule {
     layers?: LayerInfo[];
     error?: string;
   };
+  parsePsdCompact(dataSize: number): {
+    handle?: number;
+    width?: number;
+    height?: number;
+    layerTableSize?: number;
+    error?: string;
+  };
+  getLayerTable(handle: number): Uint8Array | null;
   renderCompositeWithQt(handle: number, hiddenLayerIds: number[], shownLayerIds: number[]): {
     width?: number;
     height?: number;
     data?: Uint8ClampedArray;
     error?: string;
   };
+  beginParse(dataSize: number): ParseStep;
+  continueParse(parseId: number): ParseStep;
+  cancelParse(parseId: number): void;
+  getLayerOrdinals(handle: number): Int32Array;
+  hitTest(handle: number, x: number, y: number, alpha: boolean): { layers?: number[]; error?: string };
+  hitTestPrecise(handle: number, x: number, y: number): { layerId?: number; error?: string };
+  queryRegion(handle: number, x: number, y: number, width: number, height: number): {
+    layers?: number[];
+    error?: string;
+  };
+  renderCompositeWithStates(handle: number, stateCount: number): {
+    width?: number;
+    height?: number;
+    data?: Uint8ClampedArray;
+    visibility?: LayerVisibility[];
+    error?: string;
+  };
   getLayerImage(handle: number, layerId: number): {
     width?: number;
     height?: number;
@@ -29,8 +73,19 @@ interface PsdRunModule {
     data?: Uint8ClampedArray;
     error?: string;
   };
-  exportLayerJson(handle: number): {
+  exportLayerJson(handle: number, rootLayerId?: number, maxDepth?: number, fields?: number): {
+    json?: string;
+    version?: number;
+    error?: string;
+  };
+  exportLayerJsonView(handle: number, rootLayerId: number, maxDepth: number, fields: number): {
+    data?: Uint8Array;
+    version?: number;
+    error?: string;
+  };
+  exportChangedLayersJson(handle: number, sinceVersion: number, fields: number): {
     json?: string;
+    version?: number;
     error?: string;
   };
   getHintsJson(handle: number): {
@@ -45,6 +100,25 @@ interface PsdRunModule {
     ok?: boolean;
     error?: string;
   };
+  applyAndRender(handle: number, deltaSize: number): {
+    x?: number;
+    y?: number;
+    width?: number;
+    height?: number;
+    data?: Uint8ClampedArray;
+    visibility?: LayerVisibility[];
+    error?: string;
+  };
+  applyTextUpdates(handle: number, updates: TextUpdate[], render: boolean): {
+    applied?: number;
+    failed?: number[];
+    x?: number;
+    y?: number;
+    width?: number;
+    height?: number;
+    data?: Uint8ClampedArray;
+    error?: string;
+  };
   releaseParser(handle: number): void;
   allocateFontBuffer(size: number): void;
   getFontBufferView(): Uint8Array;
@@ -54,6 +128,120 @@ interface PsdRunModule {
     error?: string;
   };
   getRegisteredFonts(): string[];
+  getMemoryStats(): MemoryStats;
+  trimMemory(): MemoryStats;
+  getStaticPlugins(): { category: string; name: string; keys: string[] }[];
+  getTimings(): PhaseTiming[];
+  clearTimings(): void;
+  setStatsEnabled(enabled: boolean): void;
+  getStats(handle: number): ModuleStats & { error?: string };
+  resetStats(handle: number): void;
+  setCompositeCacheBudget(handle: number, bytes: number): void;
+  setDynamicLayers(handle: number, layerIds: number[]): void;
+  prerenderComposite(handle: number, overrides: LayerVisibility[]): {
+    ok?: boolean;
+    error?: string;
+  };
+  getVisibilityState(handle: number): { visibility?: LayerVisibility[]; error?: string };
+}
+
+// Record a loader phase as a performance measure ("psdrun:<name>")
+export function measurePhase(name: string, start: number): void {
+  performance.measure(`psdrun:${name}`, { start, end: performance.now() });
+}
+
+// "lite" omits adjustment layer plugins and is optimized for size. Those
+// documents render without their adjustments, so it is only used when
+// requested with ?wasm=lite, never picked automatically.
+function preferredModuleVariant(): 'full' | 'lite' {
+  const requested = new URLSearchParams(window.location.search).get('wasm');
+  return requested === 'lite' ? 'lite' : 'full';
+}
+
+// build-wasm.sh writes psdrun_qt<variant>.manifest.json naming content-hashed
+// copies of the module, which are safe to cache indefinitely.
+interface ModuleManifest {
+  js: string;
+  wasm: string;
+}
+
+interface ModuleArtifacts {
+  variant: 'full' | 'lite';
+  jsUrl: string;
+  wasmUrl: string;
+  immutable: boolean;
+}
+
+const MODULE_CACHE_NAME = 'psd-run-wasm';
+
+async function resolveArtifacts(variant: 'full' | 'lite'): Promise<ModuleArtifacts | null> {
+  const suffix = variant === 'lite' ? '-lite' : '';
+  try {
+    const response = await fetch(`/wasm/psdrun_qt${suffix}.manifest.json`, { cache: 'no-cache' });
+    if (!response.ok) return null;
+    const manifest = await response.json() as ModuleManifest;
+    return { variant, jsUrl: `/wasm/${manifest.js}`, wasmUrl: `/wasm/${manifest.wasm}`, immutable: true };
+  } catch {
+    return null;
+  }
+}
+
+// Hashed artifacts are kept in Cache Storage (opt out with localStorage
+// psd-run:wasm-cache=off) so repeat launches skip the download even after
+// HTTP cache eviction. Responses come back with their URL intact, which
+// keeps the browser's compiled-code cache for instantiateStreaming usable.
+function persistentCacheEnabled(): boolean {
+  return typeof caches !== 'undefined' && localStorage.getItem('psd-run:wasm-cache') !== 'off';
+}
+
+async function fetchArtifact(url: string, immutable: boolean): Promise<Response> {
+  if (!immutable || !persistentCacheEnabled()) return fetch(url);
+  const cache = await caches.open(MODULE_CACHE_NAME);
+  const cached = await cache.match(url);
+  if (cached) return cached;
+  const response = await fetch(url);
+  // Not awaited: put() reads its clone to the end, which would hold back
+  // streaming compilation of the returned body until the download is done
+  if (response.ok) {
+    cache.put(url, response.clone()).catch((e) => {
+      console.warn(`[QtRenderer] Failed to cache ${url}:`, e);
+    });
+  }
+  return response;
+}
+
+function artifactVariant(path: string): 'full' | 'lite' {
+  return path.startsWith('/wasm/psdrun_qt-lite.') ? 'lite' : 'full';
+}
+
+// Drop cached artifacts of older builds, keeping the newest build of each
+// variant so switching with ?wasm=lite and back does not download again.
+// A variant whose manifest cannot be read is left alone.
+async function pruneArtifactCache(loaded: ModuleArtifacts): Promise<void> {
+  if (!persistentCacheEnabled()) return;
+  const other = await resolveArtifacts(loaded.variant === 'lite' ? 'full' : 'lite');
+  const current = new Map<'full' | 'lite', string[]>([[loaded.variant, [loaded.jsUrl, loaded.wasmUrl]]]);
+  if (other) current.set(other.variant, [other.jsUrl, other.wasmUrl]);
+
+  const cache = await caches.open(MODULE_CACHE_NAME);
+  for (const request of await cache.keys()) {
+    const path = new URL(request.url).pathname;
+    const keep = current.get(artifactVariant(path));
+    if (keep && !keep.includes(path)) await cache.delete(request);
+  }
+}
+
+async function instantiateWasm(
+  artifacts: ModuleArtifacts,
+  imports: WebAssembly.Imports
+): Promise<WebAssembly.WebAssemblyInstantiatedSource> {
+  const response = await fetchArtifact(artifacts.wasmUrl, artifacts.immutable);
+  if (!response.ok) throw new Error(`Failed to fetch WASM binary: ${response.status}`);
+  // Compile while downloading; needs the application/wasm MIME type
+  if (response.headers.get('Content-Type')?.startsWith('application/wasm')) {
+    return WebAssembly.instantiateStreaming(response, imports);
+  }
+  return WebAssembly.instantiate(await response.arrayBuffer(), imports);
 }
 
 class QtRenderer {
@@ -61,6 +249,8 @@ class QtRenderer {
   private initPromise: Promise<void> | null = null;
   private parserHandles: Map<string, number> = new Map();
   private psdDataCache: Map<string, ArrayBuffer> = new Map();
+  private layerOrdinals: Map<string, Map<number, number>> = new Map();
+  private textDecoder = new TextDecoder();
 
   async initialize(): Promise<void> {
     if (this.module) return;
@@ -71,8 +261,24 @@ class QtRenderer {
 
   private async loadModule(): Promise<void> {
     try {
-      const cacheBuster = Date.now();
-      const response = await fetch(`/wasm/psdrun_qt.js?v=${cacheBuster}`);
+      let phaseStart = performance.now();
+      let artifacts = await resolveArtifacts(preferredModuleVariant());
+      if (!artifacts) {
+        // Lite variant not deployed; fall back to the full module
+        artifacts = await resolveArtifacts('full');
+      }
+      if (!artifacts) {
+        // No manifest (older build output): unhashed files with a cache buster
+        const cacheBuster = Date.now();
+        artifacts = {
+          variant: 'full',
+          jsUrl: `/wasm/psdrun_qt.js?v=${cacheBuster}`,
+          wasmUrl: `/wasm/psdrun_qt.wasm?v=${cacheBuster}`,
+          immutable: false,
+        };
+      }
+
+      const response = await fetchArtifact(artifacts.jsUrl, artifacts.immutable);
       if (!response.ok) {
         throw new Error(`Failed to fetch WASM module: ${response.status}`);
       }
@@ -80,13 +286,31 @@ class QtRenderer {
       const scriptText = await response.text();
       const scriptFunc = new Function(scriptText + '\nreturn psdrun_qt_entry;');
       const factory = scriptFunc() as (options?: Record<string, unknown>) => Promise<PsdRunModule>;
-
-      this.module = await factory({
-        locateFile: (path: string) => `/wasm/${path}?v=${cacheBuster}`
+      measurePhase('fetchScript', phaseStart);
+
+      phaseStart = performance.now();
+      const resolved = artifacts;
+      this.module = await new Promise<PsdRunModule>((resolve, reject) => {
+        factory({
+          instantiateWasm: (
+            imports: WebAssembly.Imports,
+            receive: (instance: WebAssembly.Instance, module: WebAssembly.Module) => void
+          ) => {
+            instantiateWasm(resolved, imports)
+              .then(({ instance, module }) => receive(instance, module), reject);
+            return {};
+          }
+        }).then(resolve, reject);
       });
+      measurePhase('instantiate', phaseStart);
 
-      console.log('[QtRenderer] Module initialized');
+      console.log(`[QtRenderer] Module initialized (${artifacts.variant})`);
+      if (artifacts.immutable) {
+        pruneArtifactCache(artifacts).catch(() => {});
+      }
+      phaseStart = performance.now();
       await this.loadDefaultFonts();
+      measurePhase('fonts', phaseStart);
     } catch (error) {
       this.initPromise = null;
       throw error;
@@ -134,7 +358,12 @@ class QtRenderer {
     this.psdDataCache.set(file, data);
   }
 
-  async parsePsd(file: string): Promise<{ handle: number; layers: LayerInfo[]; width: number; height: number }> {
+  // Parse the cached data for file. A signal that aborts while the module is
+  // between stages cancels the parse (rejecting with an AbortError).
+  async parsePsd(
+    file: string,
+    options: { onProgress?: (progress: ParseProgress) => void; signal?: AbortSignal } = {}
+  ): Promise<{ handle: number; layers: LayerInfo[]; width: number; height: number }> {
     await this.initialize();
     if (!this.module) throw new Error('Module not initialized');
 
@@ -152,20 +381,47 @@ class QtRenderer {
     const bufferView = this.module.getBufferView();
     bufferView.set(bytes);
 
-    const result = this.module.parsePsd(bytes.length);
+    // One stage per call, yielding in between for progress and cancellation
+    const parseStart = performance.now();
+    let result = this.module.beginParse(bytes.length);
     if (result.error) throw new Error(`Failed to parse PSD: ${result.error}`);
-    if (!result.handle) throw new Error('No handle returned');
+    const parseId = result.parseId!;
+    while (result.handle === undefined) {
+      options.onProgress?.({
+        stage: result.stage ?? 0,
+        stages: result.stages ?? 0,
+        stageName: result.stageName ?? 'widgetModel',
+        bytes: result.bytes ?? bytes.length,
+        layers: result.layers ?? 0,
+      });
+      await new Promise(resolve => setTimeout(resolve, 0));
+      if (options.signal?.aborted) {
+        this.module.cancelParse(parseId);
+        throw new DOMException('PSD parse cancelled', 'AbortError');
+      }
+      result = this.module.continueParse(parseId);
+      if (result.error) throw new Error(`Failed to parse PSD: ${result.error}`);
+    }
+    const handle = result.handle!;
+
+    this.parserHandles.set(file, handle);
+    this.layerOrdinals.delete(file);
 
-    this.parserHandles.set(file, result.handle);
+    // One typed-array copy instead of an embind object per layer
+    const tableView = this.module.getLayerTable(handle);
+    const layers = tableView ? new LayerTable(tableView).toLayerInfos() : [];
+    measurePhase('parse', parseStart);
 
     return {
-      handle: result.handle,
-      layers: result.layers || [],
+      handle,
+      layers,
       width: result.width || 0,
       height: result.height || 0
     };
   }
 
+  // hiddenLayerIds/shownLayerIds replace the module's own-visibility
+  // overrides; folders still hide their contents
   async renderCompositeWithQt(
     file: string,
     hiddenLayerIds: number[],
@@ -191,6 +447,86 @@ class QtRenderer {
     };
   }
 
+  // Layer id -> ordinal, the index into the state array taken by
+  // renderCompositeWithStates (fetched once per document)
+  async getLayerOrdinals(file: string): Promise<Map<number, number>> {
+    await this.initialize();
+    if (!this.module) throw new Error('Module not initialized');
+
+    const handle = this.parserHandles.get(file);
+    if (handle === undefined) throw new Error(`No parser for file ${file}`);
+
+    let ordinals = this.layerOrdinals.get(file);
+    if (!ordinals) {
+      ordinals = new Map();
+      this.module.getLayerOrdinals(handle).forEach((id, ordinal) => ordinals!.set(id, ordinal));
+      this.layerOrdinals.set(file, ordinals);
+    }
+    return ordinals;
+  }
+
+  // Render with all own-visibility overrides given as one byte per layer
+  // ordinal (0 none, 1 hidden, 2 shown), copied into the module in one go
+  async renderCompositeWithStates(file: string, states: Uint8Array): Promise<StateDeltaResult> {
+    await this.initialize();
+    if (!this.module) throw new Error('Module not initialized');
+
+    const handle = this.parserHandles.get(file);
+    if (handle === undefined) throw new Error(`No parser for file ${file}`);
+
+    this.module.allocateBuffer(states.length);
+    this.module.getBufferView().set(states);
+    const result = this.module.renderCompositeWithStates(handle, states.length);
+    if (result.error) throw new Error(`Render failed: ${result.error}`);
+    if (!result.data) throw new Error('No render data');
+
+    return {
+      frame: { width: result.width!, height: result.height!, data: result.data },
+      visibility: result.visibility ?? [],
+    };
+  }
+
+  // Visible layers under a canvas point, topmost first; with alpha, only
+  // those with a non-transparent pixel there
+  async hitTest(file: string, x: number, y: number, alpha = false): Promise<number[]> {
+    await this.initialize();
+    if (!this.module) throw new Error('Module not initialized');
+
+    const handle = this.parserHandles.get(file);
+    if (handle === undefined) throw new Error(`No parser for file ${file}`);
+
+    const result = this.module.hitTest(handle, Math.floor(x), Math.floor(y), alpha);
+    if (result.error) throw new Error(`hitTest failed: ${result.error}`);
+    return result.layers ?? [];
+  }
+
+  // Topmost visible layer with a non-transparent pixel at a canvas point, or
+  // null; checked against coverage masks the module derives once per layer
+  async hitTestPrecise(file: string, x: number, y: number): Promise<number | null> {
+    await this.initialize();
+    if (!this.module) throw new Error('Module not initialized');
+
+    const handle = this.parserHandles.get(file);
+    if (handle === undefined) throw new Error(`No parser for file ${file}`);
+
+    const result = this.module.hitTestPrecise(handle, Math.floor(x), Math.floor(y));
+    if (result.error) throw new Error(`hitTestPrecise failed: ${result.error}`);
+    return result.layerId !== undefined && result.layerId >= 0 ? result.layerId : null;
+  }
+
+  // Visible layers whose bounds intersect a canvas rect, topmost first
+  async queryRegion(file: string, x: number, y: number, width: number, height: number): Promise<number[]> {
+    await this.initialize();
+    if (!this.module) throw new Error('Module not initialized');
+
+    const handle = this.parserHandles.get(file);
+    if (handle === undefined) throw new Error(`No parser for file ${file}`);
+
+    const result = this.module.queryRegion(handle, x, y, width, height);
+    if (result.error) throw new Error(`queryRegion failed: ${result.error}`);
+    return result.layers ?? [];
+  }
+
   async getLayerImage(file: string, layerId: number): Promise<RenderedImage> {
     await this.initialize();
     if (!this.module) throw new Error('Module not initialized');
@@ -214,7 +550,7 @@ class QtRenderer {
     };
   }
 
-  async exportLayerJson(file: string): Promise<string> {
+  async exportLayerJson(file: string, options: LayerJsonOptions = {}): Promise<string> {
     await this.initialize();
     if (!this.module) throw new Error('Module not initialized');
 
@@ -224,9 +560,33 @@ class QtRenderer {
       handle = parsed.handle;
     }
 
-    const result = this.module.exportLayerJson(handle);
+    const result = this.module.exportLayerJsonView(
+      handle,
+      options.rootLayerId ?? -1,
+      options.maxDepth ?? -1,
+      options.fields ?? LayerJsonFields.All
+    );
     if (result.error) throw new Error(`exportLayerJson failed: ${result.error}`);
-    return result.json || '{}';
+    // Decode straight from WASM memory before the next module call reuses it
+    return result.data ? this.textDecoder.decode(result.data) : '{}';
+  }
+
+  // Layers whose exported state changed after sinceVersion; pass the returned
+  // version on the next call to receive only newer changes.
+  async exportChangedLayersJson(
+    file: string,
+    sinceVersion: number,
+    fields: number = LayerJsonFields.All
+  ): Promise<{ json: string; version: number }> {
+    await this.initialize();
+    if (!this.module) throw new Error('Module not initialized');
+
+    const handle = this.parserHandles.get(file);
+    if (handle === undefined) throw new Error(`No parser for file ${file}`);
+
+    const result = this.module.exportChangedLayersJson(handle, sinceVersion, fields);
+    if (result.error) throw new Error(`exportChangedLayersJson failed: ${result.error}`);
+    return { json: result.json || '{}', version: result.version || 0 };
   }
 
   async getHintsJson(file: string): Promise<string> {
@@ -264,6 +624,54 @@ class QtRenderer {
     if (result.error) throw new Error(`setLayerText failed: ${result.error}`);
   }
 
+  // Apply a state delta (see StateDeltaWriter) and render once. Returns the
+  // re-rendered area with x/y set, or null when the delta changed nothing.
+  async applyAndRender(file: string, delta: Uint8Array): Promise<StateDeltaResult> {
+    await this.initialize();
+    if (!this.module) throw new Error('Module not initialized');
+
+    const handle = this.parserHandles.get(file);
+    if (handle === undefined) throw new Error(`No parser for file ${file}`);
+
+    this.module.allocateBuffer(delta.length);
+    this.module.getBufferView().set(delta);
+    const result = this.module.applyAndRender(handle, delta.length);
+    if (result.error) throw new Error(`applyAndRender failed: ${result.error}`);
+
+    const frame = result.data ? {
+      width: result.width!,
+      height: result.height!,
+      x: result.x,
+      y: result.y,
+      data: result.data
+    } : null;
+    return { frame, visibility: result.visibility ?? [] };
+  }
+
+  // Set the text of many layers in one call. With render, the affected part
+  // of the last composite is re-rendered once and returned as frame.
+  async applyTextUpdates(file: string, updates: TextUpdate[], render = true): Promise<TextUpdateResult> {
+    await this.initialize();
+    if (!this.module) throw new Error('Module not initialized');
+
+    const handle = this.parserHandles.get(file);
+    if (handle === undefined) throw new Error(`No parser for file ${file}`);
+
+    const result = this.module.applyTextUpdates(handle, updates, render);
+    if (result.error) throw new Error(`applyTextUpdates failed: ${result.error}`);
+    return {
+      applied: result.applied || 0,
+      failed: result.failed || [],
+      frame: result.data ? {
+        width: result.width!,
+        height: result.height!,
+        x: result.x,
+        y: result.y,
+        data: result.data
+      } : null
+    };
+  }
+
   async registerFont(data: ArrayBuffer, filename: string): Promise<{ fontId: number; families: string[] }> {
     await this.initialize();
     if (!this.module) throw new Error('Module not initialized');
@@ -292,6 +700,105 @@ class QtRenderer {
       this.parserHandles.delete(file);
     }
     this.psdDataCache.delete(file);
+    this.layerOrdinals.delete(file);
+    this.module.trimMemory();
+  }
+
+  // Loader phases plus the module's own phase log, ordered by start time
+  getStartupTimings(): PhaseTiming[] {
+    const timings: PhaseTiming[] = performance.getEntriesByType('measure')
+      .filter(entry => entry.name.startsWith('psdrun:'))
+      .map(entry => ({ name: entry.name.slice('psdrun:'.length), start: entry.startTime, duration: entry.duration }));
+    if (this.module) {
+      for (const timing of this.module.getTimings()) {
+        timings.push({ ...timing, name: `module:${timing.name}` });
+      }
+    }
+    return timings.sort((a, b) => a.start - b.start);
+  }
+
+  // Only our own measures: the page may record others
+  clearTimings(): void {
+    const names = new Set(performance.getEntriesByType('measure')
+      .map(entry => entry.name)
+      .filter(name => name.startsWith('psdrun:')));
+    for (const name of names) performance.clearMeasures(name);
+    this.module?.clearTimings();
+  }
+
+  // Per-call counters are off by default; enabling them adds a timer per call
+  setStatsEnabled(enabled: boolean): void {
+    this.module?.setStatsEnabled(enabled);
+  }
+
+  getStats(file: string): ModuleStats | null {
+    const handle = this.parserHandles.get(file);
+    if (!this.module || handle === undefined) return null;
+    const stats = this.module.getStats(handle);
+    return stats.error ? null : stats;
+  }
+
+  resetStats(file: string): void {
+    const handle = this.parserHandles.get(file);
+    if (this.module && handle !== undefined) this.module.resetStats(handle);
+  }
+
+  // Render the state the given own-visibility overrides would give into the
+  // module's frame cache without switching to it; a later render of the same
+  // state is then a copy
+  async prerenderComposite(file: string, overrides: LayerVisibility[]): Promise<void> {
+    await this.initialize();
+    if (!this.module) throw new Error('Module not initialized');
+
+    const handle = this.parserHandles.get(file);
+    if (handle === undefined) throw new Error(`No parser for file ${file}`);
+
+    const result = this.module.prerenderComposite(handle, overrides);
+    if (result.error) throw new Error(`prerenderComposite failed: ${result.error}`);
+  }
+
+  // Layers whose effective visibility (own flag or override, and every
+  // parent folder shown) differs from their PSD flag
+  async getVisibilityState(file: string): Promise<LayerVisibility[]> {
+    await this.initialize();
+    if (!this.module) throw new Error('Module not initialized');
+
+    const handle = this.parserHandles.get(file);
+    if (handle === undefined) throw new Error(`No parser for file ${file}`);
+
+    const result = this.module.getVisibilityState(handle);
+    if (result.error) throw new Error(`getVisibilityState failed: ${result.error}`);
+    return result.visibility ?? [];
+  }
+
+  // Bytes of finished frames the module keeps per document for revisiting
+  // earlier visibility/text states (default 64 MiB, 0 disables)
+  setCompositeCacheBudget(file: string, bytes: number): void {
+    const handle = this.parserHandles.get(file);
+    if (this.module && handle !== undefined) this.module.setCompositeCacheBudget(handle, bytes);
+  }
+
+  // Layers the app will toggle or retext at runtime; everything else is
+  // composited once into cached planes and reused across frames
+  setDynamicLayers(file: string, layerIds: number[]): void {
+    const handle = this.parserHandles.get(file);
+    if (this.module && handle !== undefined) this.module.setDynamicLayers(handle, layerIds);
+  }
+
+  // Compiled-in qtpsd plugins and the PSD tags they handle
+  getStaticPlugins(): { category: string; name: string; keys: string[] }[] {
+    if (!this.module) return [];
+    return this.module.getStaticPlugins();
+  }
+
+  getMemoryStats(): MemoryStats | null {
+    if (!this.module) return null;
+    return this.module.getMemoryStats();
+  }
+
+  trimMemory(): MemoryStats | null {
+    if (!this.module) return null;
+    return this.module.trimMemory();
   }
 
   invalidateForFonts(): void {
@@ -300,6 +807,7 @@ class QtRenderer {
       this.module.releaseParser(handle);
     }
     this.parserHandles.clear();
+    this.module.trimMemory();
   }
 }
 
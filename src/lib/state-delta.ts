@@ -0,0 +1,54 @@
+// Copyright (C) 2026 Signal Slot Inc.
+// SPDX-License-Identifier: MIT
+//
+// Encoder for the binary state delta consumed by applyAndRender
+// (see applyStateDelta() in psdrun_core.cpp for the layout).
+
+const STATE_DELTA_MAGIC = 0x44525350; // "PSRD"
+const STATE_DELTA_VERSION = 2;
+
+// SetOpacity (4) is reserved in the format and rejected by the module
+enum Op {
+  ResetVisibility, SetVisible, ClearVisible, SetText,
+}
+
+const utf8 = new TextEncoder();
+
+export class StateDeltaWriter {
+  private words: number[] = [STATE_DELTA_MAGIC, STATE_DELTA_VERSION];
+  private texts: { at: number; bytes: Uint8Array }[] = [];
+
+  // Drop all visibility overrides (back to the PSD's own visibility)
+  resetVisibility(): this {
+    this.words.push(Op.ResetVisibility);
+    return this;
+  }
+
+  // Override a layer's own visibility; the module applies folder hiding
+  setVisible(layerId: number, visible: boolean): this {
+    this.words.push(Op.SetVisible, layerId, visible ? 1 : 0);
+    return this;
+  }
+
+  clearVisible(layerId: number): this {
+    this.words.push(Op.ClearVisible, layerId);
+    return this;
+  }
+
+  setText(layerId: number, text: string): this {
+    const bytes = utf8.encode(text);
+    this.words.push(Op.SetText, layerId, bytes.length);
+    this.texts.push({ at: this.words.length, bytes });
+    // Placeholder words for the zero-padded UTF-8 bytes
+    for (let i = 0; i < Math.ceil(bytes.length / 4); i++) this.words.push(0);
+    return this;
+  }
+
+  finish(): Uint8Array {
+    const out = new Uint8Array(this.words.length * 4);
+    const view = new DataView(out.buffer);
+    this.words.forEach((word, i) => view.setInt32(i * 4, word, true));
+    for (const { at, bytes } of this.texts) out.set(bytes, at * 4);
+    return out;
+  }
+}
@@ -43,6 +43,104 @@ export interface RenderedImage {
   data: Uint8ClampedArray | null;
 }
 
+// One edit for applyTextUpdates
+export interface TextUpdate {
+  id: number;
+  text: string;
+}
+
+export interface TextUpdateResult {
+  applied: number;
+  failed: number[];
+  // Re-rendered part of the composite (x/y set), when rendering was requested
+  frame: RenderedImage | null;
+}
+
+// Load stage about to run; 'done' once the document is complete
+export type ParseStageName = 'widgetModel' | 'scene' | 'exporterModel' | 'done';
+
+// Staged parse progress: stages completed of stages, the document size and,
+// once the first stage is done, its layer count
+export interface ParseProgress {
+  stage: number;
+  stages: number;
+  stageName: ParseStageName;
+  bytes: number;
+  layers: number;
+}
+
+export interface LayerVisibility {
+  id: number;
+  visible: boolean;
+}
+
+export interface StateDeltaResult {
+  // Re-rendered part of the composite (x/y set), null if nothing changed
+  frame: RenderedImage | null;
+  // Layers whose effective visibility flipped
+  visibility: LayerVisibility[];
+}
+
+// WASM heap usage (bytes). heapSize never shrinks; used/free show how much
+// of it is live versus available for reuse.
+export interface MemoryStats {
+  heapSize: number;
+  heapMax: number;
+  used: number;
+  free: number;
+  dataBuffer: number;
+  fontBuffer: number;
+  parsers: number;
+}
+
+// Startup/phase timing on the performance.now() timebase. Names starting
+// with "module:" come from the WASM module, the rest from the JS loader.
+export interface PhaseTiming {
+  name: string;
+  start: number;
+  duration: number;
+}
+
+export interface CallStats {
+  count: number;
+  totalMs: number;
+  maxMs: number;
+}
+
+// Cumulative per-document counters from getStats (opt-in via setStatsEnabled)
+export interface ModuleStats {
+  enabled: boolean;
+  calls: Record<string, CallStats>;
+  bytesCopied: number;
+  pixelsComposited: number;
+  cacheHits: number;
+  cacheMisses: number;
+  layersVisited: number;
+  layersCulled: number;
+  frameCacheHits: number;
+  frameCacheMisses: number;
+}
+
+// Field groups for exportLayerJson (layerId, name and type are always present)
+export const LayerJsonFields = {
+  Rect: 0x01,
+  Opacity: 0x02,
+  Visible: 0x04,
+  Text: 0x08,
+  Shape: 0x10,
+  Folder: 0x20,
+  Image: 0x40,
+  Hint: 0x80,
+  All: 0xff,
+  Version: 0x100,  // opt-in, not part of All
+} as const;
+
+export interface LayerJsonOptions {
+  rootLayerId?: number;  // export only this subtree
+  maxDepth?: number;     // 0 = roots only, omitted = unlimited
+  fields?: number;       // bitmask of LayerJsonFields
+}
+
 export interface LayerTreeNode {
   layer: LayerInfo;
   children: LayerTreeNode[];
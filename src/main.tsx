@@ -4,6 +4,20 @@
 import React from 'react'
 import ReactDOM from 'react-dom/client'
 import App from './components/App'
+import { qtRenderer } from './lib/qt-renderer'
+import { usePsdStore } from './stores/psd-store'
+
+// Hook for bench/cold-start.mjs; only installed when the page is opened with ?bench
+if (new URLSearchParams(window.location.search).has('bench')) {
+  (window as unknown as Record<string, unknown>).__psdRunBench = {
+    loadPsd: async (bytes: Uint8Array, fileName: string) => {
+      await usePsdStore.getState().loadPsd(bytes.slice().buffer, fileName)
+      const error = usePsdStore.getState().error
+      if (error) throw new Error(error)
+    },
+    timings: () => qtRenderer.getStartupTimings(),
+  }
+}
 
 ReactDOM.createRoot(document.getElementById('root')!).render(
   <React.StrictMode>
@@ -4,7 +4,6 @@
 import { create } from 'zustand';
 import type { InteractionConfig, InteractionElement, LayerInfo } from '../lib/types';
 import { usePsdStore } from './psd-store';
-import { qtRenderer } from '../lib/qt-renderer';
 
 // Find the nearest ancestor screen folder for a layer
 // Layers are in pre-order: walk BACKWARD to find parent groups
@@ -115,19 +114,20 @@ export const useInteractionStore = create<InteractionState & InteractionActions>
       dynamicTexts: initialTexts,
     });
 
-    // Initialize PSD text layers via WASM, then apply screen visibility + recomposite
+    // Elements that change within a screen; screen switches re-cache the rest
+    const dynamicTypes = new Set(['display', 'dynamic_text', 'clock', 'popup', 'highlight']);
+    psdState.setDynamicLayers(config.elements.filter(e => dynamicTypes.has(e.type)).map(e => e.layerId));
+
+    // Initial PSD texts best-effort, so a bad text layer id cannot block the
+    // screen. They are rendered and patched in themselves: the screen delta
+    // only renders where visibility flips, often nowhere for the saved screen.
     (async () => {
-      for (const elem of config.elements) {
-        if (elem.type === 'display' || elem.type === 'dynamic_text') {
-          try {
-            await qtRenderer.setLayerText('main', elem.layerId, elem.value ?? '--');
-          } catch (e) {
-            console.warn('[interaction] Failed to set text for layer', elem.layerId, e);
-          }
-        }
-      }
+      await usePsdStore.getState().updateTexts(config.elements
+        .filter(elem => elem.type === 'display' || elem.type === 'dynamic_text')
+        .map(elem => ({ id: elem.layerId, text: elem.value ?? '--' })));
       applyScreenVisibility(config, config.initialScreen, new Set(), new Map());
     })();
+    schedulePrerender(config, config.initialScreen, elementScreenMap, new Map());
 
     // Start clocks if any
     const clockElements = config.elements.filter(e => e.type === 'clock');
@@ -151,6 +151,7 @@ export const useInteractionStore = create<InteractionState & InteractionActions>
     // Clear popups on navigation, keep highlights
     set({ currentScreen: screenName, activePopups: new Set() });
     applyScreenVisibility(config, screenName, new Set(), get().selectedHighlights);
+    schedulePrerender(config, screenName, get().elementScreenMap, get().selectedHighlights);
 
     // Start timers that trigger on this screen
     set({ screenTimerIds: startScreenTimers(config, screenName, get().navigateToScreen) });
@@ -186,10 +187,8 @@ export const useInteractionStore = create<InteractionState & InteractionActions>
         newTexts.set(elem.layerId, timeStr);
         set({ dynamicTexts: newTexts });
 
-        // Update PSD text layer + recomposite
-        qtRenderer.setLayerText('main', elem.layerId, timeStr).then(() => {
-          usePsdStore.getState().recomposite();
-        }).catch(e => console.warn('[interaction] Clock setLayerText failed:', e));
+        // Update PSD text layer + re-render its rows
+        usePsdStore.getState().updateTexts([{ id: elem.layerId, text: timeStr }]);
       }, 1000);
       newTimers.set(elem.layerId, timerId);
     }
@@ -264,9 +263,7 @@ export const useInteractionStore = create<InteractionState & InteractionActions>
         }
 
         setDynamicText(displayElem.layerId, next);
-        qtRenderer.setLayerText('main', displayElem.layerId, next).then(() => {
-          usePsdStore.getState().recomposite();
-        }).catch(e => console.warn('[interaction] Failed to update text layer:', e));
+        usePsdStore.getState().updateTexts([{ id: displayElem.layerId, text: next }]);
       } else {
         // Multiple displays: each holds one character, ordered left → right
         // Check if all positions are filled
@@ -287,19 +284,12 @@ export const useInteractionStore = create<InteractionState & InteractionActions>
         }
         setDynamicText(displayElems[displayElems.length - 1].layerId, digit);
 
-        // Update all PSD text layers via WASM + single recomposite
-        (async () => {
-          const state = get();
-          for (const d of displayElems) {
-            const text = state.dynamicTexts.get(d.layerId) || emptyValue;
-            try {
-              await qtRenderer.setLayerText('main', d.layerId, text);
-            } catch (e) {
-              console.warn('[interaction] Failed to update text layer:', d.layerId, e);
-            }
-          }
-          usePsdStore.getState().recomposite();
-        })();
+        // Update all PSD text layers in one batch + single render
+        const texts = get().dynamicTexts;
+        usePsdStore.getState().updateTexts(displayElems.map(d => ({
+          id: d.layerId,
+          text: texts.get(d.layerId) || emptyValue,
+        })));
       }
       return;
     }
@@ -390,16 +380,7 @@ export const useInteractionStore = create<InteractionState & InteractionActions>
         setDynamicText(d.layerId, d.value ?? '-');
       }
 
-      (async () => {
-        for (const d of displayElems) {
-          try {
-            await qtRenderer.setLayerText('main', d.layerId, d.value ?? '-');
-          } catch (e) {
-            console.warn('[interaction] Failed to clear text layer:', d.layerId, e);
-          }
-        }
-        usePsdStore.getState().recomposite();
-      })();
+      usePsdStore.getState().updateTexts(displayElems.map(d => ({ id: d.layerId, text: d.value ?? '-' })));
       return;
     }
   },
@@ -413,6 +394,8 @@ export const useInteractionStore = create<InteractionState & InteractionActions>
   clear: () => {
     get().stopClocks();
     stopScreenTimers(get().screenTimerIds);
+    cancelPrerender();
+    usePsdStore.getState().setDynamicLayers([]);
     set({
       config: null,
       currentScreen: null,
@@ -437,21 +420,34 @@ function applyScreenVisibility(
   const psdStore = usePsdStore.getState();
   if (!psdStore.psd) return;
 
+  const overrides = screenOverrides(config, screenName, activePopups, selectedHighlights, psdStore.psd.layers);
+
+  // Single batch update + single recomposite
+  psdStore.applyChanges(overrides, []);
+}
+
+// Visibility overrides that show a screen with the given popups/highlights
+function screenOverrides(
+  config: InteractionConfig,
+  screenName: string,
+  activePopups: Set<string>,
+  selectedHighlights: Map<string, string>,
+  layers: LayerInfo[]
+): Map<number, boolean> {
+  const psdLayerIds = new Set(layers.map(l => l.id));
   const overrides = new Map<number, boolean>();
 
   // 1. Screen folders: show only the active one
   const screenElements = config.elements.filter(e => e.type === 'screen');
   for (const screen of screenElements) {
-    const layer = psdStore.psd.layers.find(l => l.id === screen.layerId);
-    if (!layer) continue;
+    if (!psdLayerIds.has(screen.layerId)) continue;
     overrides.set(screen.layerId, screen.name === screenName);
   }
 
   // 2. Elements with showOn: show only on listed screens
   const conditionalElements = config.elements.filter(e => Array.isArray(e.showOn));
   for (const elem of conditionalElements) {
-    const layer = psdStore.psd.layers.find(l => l.id === elem.layerId);
-    if (!layer) continue;
+    if (!psdLayerIds.has(elem.layerId)) continue;
     overrides.set(elem.layerId, elem.showOn!.includes(screenName));
   }
 
@@ -469,8 +465,71 @@ function applyScreenVisibility(
     overrides.set(elem.layerId, activePopups.has(elem.name!));
   }
 
-  // Single batch update + single recomposite
-  psdStore.setMultipleVisibility(overrides);
+  return overrides;
+}
+
+// Screens one step away from screenName: navigation targets of the elements
+// on it (or on no screen) and of the timers that fire on it
+function reachableScreens(
+  config: InteractionConfig,
+  screenName: string,
+  elementScreenMap: Map<number, string>
+): string[] {
+  const targets = new Set<string>();
+  for (const elem of config.elements) {
+    if (elem.type === 'timer') {
+      const triggerOn = elem.triggerOn as string[] | undefined;
+      if (elem.action === 'navigate' && elem.target && triggerOn?.includes(screenName)) targets.add(elem.target);
+      continue;
+    }
+    const owner = elementScreenMap.get(elem.layerId);
+    if (owner !== undefined && owner !== screenName) continue;
+    if ((elem.action === 'navigate' || elem.action === 'navigate_from_popup') && elem.target) {
+      targets.add(elem.target);
+    } else if (elem.action === 'navigate_conditional' && elem.targets) {
+      const dest = (elem.targets as Record<string, string>)[screenName];
+      if (dest) targets.add(dest);
+    }
+  }
+  targets.delete(screenName);
+  return [...targets].filter(name => config.screens.includes(name));
+}
+
+// Pre-render reachable screens into the module's frame cache, one per idle
+// period, so navigating to them is a copy. A new navigation cancels the rest.
+let prerenderGeneration = 0;
+
+const whenIdle: (callback: () => void) => void =
+  typeof window.requestIdleCallback === 'function'
+    ? callback => window.requestIdleCallback(callback, { timeout: 2000 })
+    : callback => window.setTimeout(callback, 50);
+
+function cancelPrerender(): void {
+  prerenderGeneration++;
+}
+
+function schedulePrerender(
+  config: InteractionConfig,
+  screenName: string,
+  elementScreenMap: Map<number, string>,
+  selectedHighlights: Map<string, string>
+): void {
+  const generation = ++prerenderGeneration;
+  const pending = reachableScreens(config, screenName, elementScreenMap);
+
+  const next = () => {
+    if (generation !== prerenderGeneration) return;
+    const psdStore = usePsdStore.getState();
+    const target = pending.shift();
+    if (!psdStore.psd || target === undefined) return;
+
+    // Navigation clears popups and keeps highlights
+    const overrides = screenOverrides(config, target, new Set(), selectedHighlights, psdStore.psd.layers);
+    psdStore.prerender(overrides)
+      .catch(e => console.warn('[interaction] Pre-render failed:', target, e))
+      .finally(() => whenIdle(next));
+  };
+  whenIdle(next);
 }
 
 // Screen timer helpers — start/stop timers that fire on specific screens
@@ -2,113 +2,58 @@
 // SPDX-License-Identifier: MIT
 
 import { create } from 'zustand';
-import type { PsdData, RenderedImage, LayerInfo } from '../lib/types';
-import { qtRenderer } from '../lib/qt-renderer';
-
-// Helper: build layer tree for visibility hierarchy
-// NOTE: layers are in pre-order (parent → children → groupEnd)
-//   index 0: group "Screen1"
-//   index 1:   layer "Child1"
-//   index 2:   group "SubGroup"
-//   index 3:     layer "Child2"
-//   index 4:   groupEnd "SubGroup"
-//   index 5: groupEnd "Screen1"
-
-// Compute bounding rect for group layers that have 0×0 from PSD
-// (groups have no pixel data; their extent is the union of children)
-function computeGroupBounds(layers: LayerInfo[]): void {
-  for (let i = 0; i < layers.length; i++) {
-    const layer = layers[i];
-    if (layer.type !== 'group') continue;
-    if (layer.width > 0 && layer.height > 0) continue;
-
-    let minX = Infinity, minY = Infinity, maxX = -Infinity, maxY = -Infinity;
-    let depth = 0;
-    for (let j = i + 1; j < layers.length; j++) {
-      const child = layers[j];
-      if (child.type === 'groupEnd') {
-        if (depth === 0) break;
-        depth--;
-      } else {
-        if (child.type === 'group') depth++;
-        if (child.width > 0 && child.height > 0) {
-          minX = Math.min(minX, child.x);
-          minY = Math.min(minY, child.y);
-          maxX = Math.max(maxX, child.x + child.width);
-          maxY = Math.max(maxY, child.y + child.height);
-        }
-      }
-    }
-
-    if (minX < Infinity) {
-      layer.x = minX;
-      layer.y = minY;
-      layer.width = maxX - minX;
-      layer.height = maxY - minY;
-    }
+import type { PsdData, RenderedImage, LayerInfo, LayerVisibility, ParseProgress, TextUpdate } from '../lib/types';
+import { qtRenderer, measurePhase } from '../lib/qt-renderer';
+import { StateDeltaWriter } from '../lib/state-delta';
+
+// Copy of the composite with a re-rendered area (x/y set) written over it
+function patchComposite(current: RenderedImage, frame: RenderedImage): RenderedImage {
+  if (!current.data || !frame.data) return current;
+  const data = new Uint8ClampedArray(current.data);
+  const x = frame.x ?? 0;
+  const y = frame.y ?? 0;
+  for (let row = 0; row < frame.height; row++) {
+    const src = row * frame.width * 4;
+    data.set(frame.data.subarray(src, src + frame.width * 4), ((y + row) * current.width + x) * 4);
   }
+  return { ...current, data };
 }
 
-function getAncestorGroupIds(layers: LayerInfo[], layerIndex: number): number[] {
-  const ancestors: number[] = [];
-  // Walk BACKWARD from the layer to find parent groups
-  let depth = 0;
-  for (let i = layerIndex - 1; i >= 0; i--) {
-    const layer = layers[i];
-    if (layer.type === 'groupEnd') {
-      depth++;
-    } else if (layer.type === 'group') {
-      if (depth === 0) {
-        ancestors.push(layer.id);
-        // keep walking to find higher ancestors
-      } else {
-        depth--;
-      }
-    }
-  }
-  return ancestors;
-}
-
-function computeEffectiveVisibility(
-  layers: LayerInfo[],
-  layerId: number,
-  overrides: Map<number, boolean>
-): boolean {
-  const layerIndex = layers.findIndex(l => l.id === layerId);
-  if (layerIndex === -1) return false;
-
-  const layer = layers[layerIndex];
-  const ownVisible = overrides.has(layerId) ? overrides.get(layerId)! : layer.visible;
-  if (!ownVisible) return false;
-
-  const ancestorIds = getAncestorGroupIds(layers, layerIndex);
-  for (const ancestorId of ancestorIds) {
-    const ancestor = layers.find(l => l.id === ancestorId);
-    if (!ancestor) continue;
-    const ancestorVisible = overrides.has(ancestorId) ? overrides.get(ancestorId)! : ancestor.visible;
-    if (!ancestorVisible) return false;
-  }
-
-  return true;
+// Copy of the effective visibility map with the module's flips applied
+function patchVisibility(current: Map<number, boolean>, flipped: LayerVisibility[]): Map<number, boolean> {
+  const next = new Map(current);
+  for (const { id, visible } of flipped) next.set(id, visible);
+  return next;
 }
 
 interface PsdState {
   psd: PsdData | null;
   composite: RenderedImage | null;
   loading: boolean;
+  parseProgress: ParseProgress | null;
   rendering: boolean;
   error: string | null;
   fileName: string | null;
   visibilityOverrides: Map<number, boolean>;
+  // Effective visibility of every layer, kept in step by the module's
+  // visibility tree (only flipped layers come back per change)
+  effectiveVisibility: Map<number, boolean>;
 }
 
-let loadingGuard = false;
+// A newer loadPsd supersedes any in flight: it aborts that parse between
+// stages, and the older call drops its results once it sees the bump
+let loadGeneration = 0;
+let loadAbort: AbortController | null = null;
 
 interface PsdActions {
   loadPsd: (data: ArrayBuffer, fileName: string) => Promise<void>;
   toggleLayerVisibility: (layerId: number) => Promise<void>;
   setMultipleVisibility: (overrides: Map<number, boolean>) => Promise<void>;
   recomposite: () => Promise<void>;
+  updateTexts: (updates: TextUpdate[]) => Promise<void>;
+  applyChanges: (overrides: Map<number, boolean>, texts: TextUpdate[]) => Promise<void>;
+  prerender: (overrides: Map<number, boolean>) => Promise<void>;
+  setDynamicLayers: (layerIds: number[]) => void;
   getEffectiveVisibility: (layerId: number) => boolean;
   getOwnVisibility: (layerId: number) => boolean;
   clear: () => void;
@@ -119,24 +64,34 @@ export const usePsdStore = create<PsdState & PsdActions>((set, get) => ({
   psd: null,
   composite: null,
   loading: false,
+  parseProgress: null,
   rendering: false,
   error: null,
   fileName: null,
   visibilityOverrides: new Map(),
+  effectiveVisibility: new Map(),
 
   loadPsd: async (data, fileName) => {
-    if (loadingGuard) return;
-    loadingGuard = true;
+    loadAbort?.abort();
+    const abort = new AbortController();
+    loadAbort = abort;
+    const generation = ++loadGeneration;
+    const superseded = () => generation !== loadGeneration;
 
-    set({ loading: true, error: null });
+    set({ loading: true, error: null, parseProgress: null });
 
     try {
       await qtRenderer.initialize();
+      if (superseded()) return;
       qtRenderer.cachePsdData('main', data);
-      const parsed = await qtRenderer.parsePsd('main');
+      const parsed = await qtRenderer.parsePsd('main', {
+        signal: abort.signal,
+        onProgress: (parseProgress) => set({ parseProgress }),
+      });
+      if (superseded()) return;
 
+      // Group bounds (union of descendants) come precomputed from the module
       const layers = parsed.layers as LayerInfo[];
-      computeGroupBounds(layers);
 
       const psdData: PsdData = {
         handle: parsed.handle,
@@ -156,122 +111,124 @@ export const usePsdStore = create<PsdState & PsdActions>((set, get) => ({
         } catch (e) {
           console.warn('[psd-store] Failed to restore hints:', e);
         }
+        if (superseded()) return;
       }
 
       // Initial render
+      const renderStart = performance.now();
       const composite = await qtRenderer.renderCompositeWithQt('main', [], []);
-      set({ composite });
+      measurePhase('firstComposite', renderStart);
+      if (superseded()) return;
+
+      const effectiveVisibility = new Map<number, boolean>();
+      for (const l of layers) {
+        if (l.type !== 'groupEnd') effectiveVisibility.set(l.id, l.visible);
+      }
+      const visibilityState = await qtRenderer.getVisibilityState('main');
+      if (superseded()) return;
+      for (const { id, visible } of visibilityState) {
+        effectiveVisibility.set(id, visible);
+      }
+      set({ composite, effectiveVisibility, visibilityOverrides: new Map() });
     } catch (err) {
+      // A superseded load's errors (including its cancellation) are moot
+      if (superseded()) return;
       set({ error: err instanceof Error ? err.message : 'Failed to load PSD' });
     } finally {
-      loadingGuard = false;
-      set({ loading: false });
+      if (!superseded()) {
+        loadAbort = null;
+        set({ loading: false, parseProgress: null });
+      }
     }
   },
 
   toggleLayerVisibility: async (layerId) => {
-    const state = get();
-    if (!state.psd) return;
-
-    const layer = state.psd.layers.find(l => l.id === layerId);
-    if (!layer) return;
-
-    const overrides = state.visibilityOverrides;
-    const currentVisible = overrides.has(layerId) ? overrides.get(layerId)! : layer.visible;
-    const newVisible = !currentVisible;
+    if (!get().psd) return;
+    await get().applyChanges(new Map([[layerId, !get().getOwnVisibility(layerId)]]), []);
+  },
 
-    const newOverrides = new Map(overrides);
-    newOverrides.set(layerId, newVisible);
+  setMultipleVisibility: (overrides) => get().applyChanges(overrides, []),
 
-    // Compute hidden/shown lists
-    const hiddenLayerIds: number[] = [];
-    const shownLayerIds: number[] = [];
+  recomposite: async () => {
+    const state = get();
+    if (!state.psd) return;
 
-    for (const l of state.psd.layers) {
-      if (l.type === 'groupEnd') continue;
-      const effectiveVisible = computeEffectiveVisibility(state.psd.layers, l.id, newOverrides);
-      if (effectiveVisible && !l.visible) {
-        shownLayerIds.push(l.id);
-      } else if (!effectiveVisible && l.visible) {
-        hiddenLayerIds.push(l.id);
+    try {
+      // Own-visibility overrides as one byte per layer ordinal
+      const ordinals = await qtRenderer.getLayerOrdinals('main');
+      const states = new Uint8Array(ordinals.size);
+      for (const [layerId, visible] of state.visibilityOverrides) {
+        const ordinal = ordinals.get(layerId);
+        if (ordinal !== undefined) states[ordinal] = visible ? 2 : 1;
       }
+      const { frame, visibility } = await qtRenderer.renderCompositeWithStates('main', states);
+      set({ composite: frame, effectiveVisibility: patchVisibility(get().effectiveVisibility, visibility) });
+    } catch (err) {
+      set({ error: err instanceof Error ? err.message : 'Failed to render' });
     }
+  },
 
-    set({ visibilityOverrides: newOverrides });
-
+  // Set text layers in one module call and patch the re-rendered rows into
+  // the current composite
+  updateTexts: async (updates) => {
+    if (updates.length === 0) return;
+    const { composite } = get();
     try {
-      const composite = await qtRenderer.renderCompositeWithQt('main', hiddenLayerIds, shownLayerIds);
-      set({ composite });
+      const { failed, frame } = await qtRenderer.applyTextUpdates('main', updates, composite !== null);
+      if (failed.length > 0) console.warn('[psd] Text update failed for layers', failed);
+      const current = get().composite;
+      if (frame && current) set({ composite: patchComposite(current, frame) });
     } catch (err) {
-      set({ error: err instanceof Error ? err.message : 'Failed to render' });
+      set({ error: err instanceof Error ? err.message : 'Failed to update text' });
     }
   },
 
-  setMultipleVisibility: async (overrides) => {
+  // Visibility overrides and text edits as one state delta: applied together
+  // by the module and rendered once, only where something changed
+  applyChanges: async (overrides, texts) => {
     const state = get();
     if (!state.psd) return;
 
     const newOverrides = new Map(state.visibilityOverrides);
-
+    const delta = new StateDeltaWriter();
     for (const [layerId, visible] of overrides) {
       newOverrides.set(layerId, visible);
+      delta.setVisible(layerId, visible);
     }
-
-    // Compute hidden/shown lists once
-    const hiddenLayerIds: number[] = [];
-    const shownLayerIds: number[] = [];
-
-    for (const l of state.psd.layers) {
-      if (l.type === 'groupEnd') continue;
-      const effectiveVisible = computeEffectiveVisibility(state.psd.layers, l.id, newOverrides);
-      if (effectiveVisible && !l.visible) {
-        shownLayerIds.push(l.id);
-      } else if (!effectiveVisible && l.visible) {
-        hiddenLayerIds.push(l.id);
-      }
-    }
+    for (const { id, text } of texts) delta.setText(id, text);
 
     set({ visibilityOverrides: newOverrides });
 
     try {
-      const composite = await qtRenderer.renderCompositeWithQt('main', hiddenLayerIds, shownLayerIds);
-      set({ composite });
+      const { frame, visibility } = await qtRenderer.applyAndRender('main', delta.finish());
+      if (visibility.length > 0) {
+        set({ effectiveVisibility: patchVisibility(get().effectiveVisibility, visibility) });
+      }
+      const current = get().composite;
+      if (frame && current) set({ composite: patchComposite(current, frame) });
     } catch (err) {
       set({ error: err instanceof Error ? err.message : 'Failed to render' });
     }
   },
 
-  recomposite: async () => {
-    const state = get();
-    if (!state.psd) return;
-
-    const hiddenLayerIds: number[] = [];
-    const shownLayerIds: number[] = [];
-
-    for (const layer of state.psd.layers) {
-      if (layer.type === 'groupEnd') continue;
-      const effectiveVisible = computeEffectiveVisibility(state.psd.layers, layer.id, state.visibilityOverrides);
-      if (effectiveVisible && !layer.visible) {
-        shownLayerIds.push(layer.id);
-      } else if (!effectiveVisible && layer.visible) {
-        hiddenLayerIds.push(layer.id);
-      }
-    }
-
-    try {
-      const composite = await qtRenderer.renderCompositeWithQt('main', hiddenLayerIds, shownLayerIds);
-      set({ composite });
-    } catch (err) {
-      set({ error: err instanceof Error ? err.message : 'Failed to render' });
-    }
+  // Warm the module's frame cache for the state these overrides would give,
+  // without changing the current one
+  prerender: async (overrides) => {
+    if (!get().psd) return;
+    const layers: LayerVisibility[] = [];
+    for (const [id, visible] of overrides) layers.push({ id, visible });
+    await qtRenderer.prerenderComposite('main', layers);
   },
 
-  getEffectiveVisibility: (layerId) => {
-    const state = get();
-    if (!state.psd) return false;
-    return computeEffectiveVisibility(state.psd.layers, layerId, state.visibilityOverrides);
+  // Layers expected to change often; the module keeps the rest in cached
+  // planes so their frames only composite these
+  setDynamicLayers: (layerIds) => {
+    if (!get().psd) return;
+    qtRenderer.setDynamicLayers('main', layerIds);
   },
 
+  getEffectiveVisibility: (layerId) => get().effectiveVisibility.get(layerId) ?? false,
+
   getOwnVisibility: (layerId) => {
     const state = get();
     if (!state.psd) return false;
@@ -288,6 +245,7 @@ export const usePsdStore = create<PsdState & PsdActions>((set, get) => ({
       error: null,
       fileName: null,
       visibilityOverrides: new Map(),
+      effectiveVisibility: new Map(),
     });
   },
 
@@ -0,0 +1,31 @@
+// Copyright (C) 2026 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+//
+// Software compositing kernels for the Photoshop blend modes, used by the
+// layer compositor for modes QPainter has no (or only an approximate)
+// composition mode for. Blend formulas follow the W3C Compositing and
+// Blending spec; opacity and fill opacity are applied in the same pass,
+// with Photoshop's different fill handling for the "special eight" modes.
+
+#ifndef PSDRUN_BLEND_H
+#define PSDRUN_BLEND_H
+
+#include <QtCore/QPoint>
+#include <QtGui/QImage>
+#include <QtGui/QRegion>
+
+#include <QtPsdCore/qpsdblend.h>
+
+// True for every mode blendModeToString() knows except pass-through
+bool hasBlendKernel(QPsdBlend::Mode mode);
+
+// Blend src onto dst with its top-left corner at pos (dst coordinates).
+// dst must be Format_ARGB32; src is converted to it when needed. opacity
+// scales the source alpha; fill does too, except for color/linear burn and
+// dodge, vivid/linear light, hard mix and difference, where it scales the
+// blend result. A non-empty clip (dst coordinates) restricts the pixels
+// written.
+void blendLayer(QImage& dst, const QPoint& pos, const QImage& src,
+                QPsdBlend::Mode mode, float opacity, float fill, const QRegion& clip = QRegion());
+
+#endif // PSDRUN_BLEND_H
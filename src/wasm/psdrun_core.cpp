@@ -0,0 +1,1837 @@
+// Copyright (C) 2026 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "psdrun_core.h"
+#include "psdrun_blend.h"
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten/emscripten.h>
+#endif
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iterator>
+
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QLocale>
+#include <QtGui/QPainter>
+
+#include <QtPsdCore/QPsdLayerRecord>
+#include <QtPsdGui/QPsdFolderLayerItem>
+#include <QtPsdGui/QPsdTextLayerItem>
+#include <QtPsdGui/QPsdShapeLayerItem>
+#include <QtPsdGui/QPsdImageLayerItem>
+#include <QtPsdGui/qpsdguiglobal.h>
+
+double nowMs() {
+#ifdef __EMSCRIPTEN__
+    return emscripten_get_now();
+#else
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// ========== Startup / phase timing ==========
+
+static constexpr size_t MaxTimings = 1024;
+
+std::vector<PhaseTiming>& phaseTimings() {
+    static std::vector<PhaseTiming> timings;
+    return timings;
+}
+
+PhaseTimer::~PhaseTimer() {
+    auto& timings = phaseTimings();
+    if (timings.size() >= MaxTimings)
+        timings.erase(timings.begin());
+    timings.push_back({ m_name, m_start, nowMs() - m_start });
+}
+
+bool g_statsEnabled = false;
+PsdStats* g_currentStats = nullptr;
+
+// ========== Document ==========
+
+// Blend modes in a fixed order; the index is the blendMode column of the
+// binary layer table and must match BLEND_MODES in layer-table.ts.
+static const struct {
+    QPsdBlend::Mode mode;
+    const char* name;
+} s_blendModes[] = {
+    { QPsdBlend::PassThrough, "passThrough" },
+    { QPsdBlend::Normal, "normal" },
+    { QPsdBlend::Dissolve, "dissolve" },
+    { QPsdBlend::Darken, "darken" },
+    { QPsdBlend::Multiply, "multiply" },
+    { QPsdBlend::ColorBurn, "colorBurn" },
+    { QPsdBlend::LinearBurn, "linearBurn" },
+    { QPsdBlend::DarkerColor, "darkerColor" },
+    { QPsdBlend::Lighten, "lighten" },
+    { QPsdBlend::Screen, "screen" },
+    { QPsdBlend::ColorDodge, "colorDodge" },
+    { QPsdBlend::LinearDodge, "linearDodge" },
+    { QPsdBlend::LighterColor, "lighterColor" },
+    { QPsdBlend::Overlay, "overlay" },
+    { QPsdBlend::SoftLight, "softLight" },
+    { QPsdBlend::HardLight, "hardLight" },
+    { QPsdBlend::VividLight, "vividLight" },
+    { QPsdBlend::LinearLight, "linearLight" },
+    { QPsdBlend::PinLight, "pinLight" },
+    { QPsdBlend::HardMix, "hardMix" },
+    { QPsdBlend::Difference, "difference" },
+    { QPsdBlend::Exclusion, "exclusion" },
+    { QPsdBlend::Subtract, "subtract" },
+    { QPsdBlend::Divide, "divide" },
+    { QPsdBlend::Hue, "hue" },
+    { QPsdBlend::Saturation, "saturation" },
+    { QPsdBlend::Color, "color" },
+    { QPsdBlend::Luminosity, "luminosity" },
+};
+
+int blendModeOrdinal(QPsdBlend::Mode mode) {
+    for (int i = 0; i < int(std::size(s_blendModes)); ++i) {
+        if (s_blendModes[i].mode == mode) return i;
+    }
+    return 1; // normal
+}
+
+std::string blendModeToString(QPsdBlend::Mode mode) {
+    return s_blendModes[blendModeOrdinal(mode)].name;
+}
+
+std::string itemTypeToString(QPsdAbstractLayerItem::Type type) {
+    switch (type) {
+        case QPsdAbstractLayerItem::Text: return "text";
+        case QPsdAbstractLayerItem::Shape: return "shape";
+        case QPsdAbstractLayerItem::Image: return "image";
+        case QPsdAbstractLayerItem::Folder: return "folder";
+        default: return "unknown";
+    }
+}
+
+// ========== Loading ==========
+
+std::string loadStageToString(LoadStage stage) {
+    switch (stage) {
+        case LoadWidgetModel: return "widgetModel";
+        case LoadScene: return "scene";
+        case LoadExporterModel: return "exporterModel";
+        default: return "done";
+    }
+}
+
+bool loadPsdStage(PsdLoad& load, std::string& error) {
+    switch (load.stage) {
+    case LoadWidgetModel: {
+        // Load using QPsdWidgetTreeItemModel (for scene rendering)
+        load.data = std::make_unique<PsdData>();
+        PsdData* psdData = load.data.get();
+        psdData->widgetModel = std::make_unique<QPsdWidgetTreeItemModel>();
+        {
+            PhaseTimer timer("parse.widgetModel");
+            psdData->widgetModel->load(load.path);
+        }
+
+        if (!psdData->widgetModel->errorMessage().isEmpty()) {
+            error = std::string("Failed to load PSD: ") + psdData->widgetModel->errorMessage().toStdString();
+            return false;
+        }
+
+        QSize size = psdData->widgetModel->size();
+        psdData->width = size.width();
+        psdData->height = size.height();
+
+        if (psdData->width == 0 || psdData->height == 0) {
+            error = "Invalid dimensions";
+            return false;
+        }
+
+        const auto* model = psdData->widgetModel.get();
+        std::function<int(const QModelIndex&)> countLayers = [&](const QModelIndex& parent) {
+            int count = model->rowCount(parent);
+            for (int row = 0; row < model->rowCount(parent); ++row) {
+                count += countLayers(model->index(row, 0, parent));
+            }
+            return count;
+        };
+        load.layerCount = countLayers(QModelIndex());
+        load.stage = LoadScene;
+        return true;
+    }
+    case LoadScene: {
+        // Create scene for Qt rendering
+        PhaseTimer timer("parse.sceneBuild");
+        PsdData* psdData = load.data.get();
+        psdData->scene = std::make_unique<QPsdScene>();
+        psdData->scene->setModel(psdData->widgetModel.get());
+        load.stage = LoadExporterModel;
+        return true;
+    }
+    case LoadExporterModel: {
+        // Load using QPsdExporterTreeItemModel (for hints + layer details)
+        PsdData* psdData = load.data.get();
+        psdData->guiModel = std::make_unique<QPsdGuiLayerTreeItemModel>();
+        psdData->exporterModel = std::make_unique<QPsdExporterTreeItemModel>();
+        psdData->exporterModel->setSourceModel(psdData->guiModel.get());
+        {
+            PhaseTimer timer("parse.exporterModel");
+            psdData->exporterModel->load(load.path);
+        }
+
+        if (!psdData->exporterModel->errorMessage().isEmpty()) {
+            error = std::string("Failed to load exporter model: ")
+                + psdData->exporterModel->errorMessage().toStdString();
+            return false;
+        }
+        load.stage = LoadDone;
+        return true;
+    }
+    case LoadDone:
+        break;
+    }
+    error = "Load already finished";
+    return false;
+}
+
+PsdData* loadPsdFile(const QString& path, std::string& error) {
+    PsdLoad load;
+    load.path = path;
+    while (load.stage != LoadDone) {
+        if (!loadPsdStage(load, error)) return nullptr;
+    }
+    return load.data.release();
+}
+
+// Id -> index lookup, filled with one walk of the model on first use
+template <typename Model>
+static QModelIndex findIndex(const Model* model, QHash<int, QPersistentModelIndex>& indexById, int layerId) {
+    if (indexById.isEmpty()) {
+        addStat(&PsdStats::cacheMisses);
+        std::function<void(const QModelIndex&)> traverse = [&](const QModelIndex& parent) {
+            for (int row = 0; row < model->rowCount(parent); ++row) {
+                auto index = model->index(row, 0, parent);
+                indexById.insert(model->layerId(index), QPersistentModelIndex(index));
+                addStat(&PsdStats::layersVisited);
+                traverse(index);
+            }
+        };
+        traverse(QModelIndex());
+    } else {
+        addStat(&PsdStats::cacheHits);
+    }
+    addStat(&PsdStats::layersVisited);
+    return indexById.value(layerId);
+}
+
+QModelIndex findExporterIndex(PsdData* psdData, int layerId) {
+    return findIndex(psdData->exporterModel.get(), psdData->exporterIndexById, layerId);
+}
+
+QModelIndex findWidgetIndex(PsdData* psdData, int layerId) {
+    return findIndex(psdData->widgetModel.get(), psdData->widgetIndexById, layerId);
+}
+
+void markLayerChanged(PsdData* psdData, int layerId) {
+    psdData->layerVersions.insert(layerId, ++psdData->version);
+}
+
+// ========== Visibility tree ==========
+
+static void updateSceneSets(PsdData* psdData, const VisibilityNode& node) {
+    psdData->sceneHiddenIds.erase(node.id);
+    psdData->sceneShownIds.erase(node.id);
+    if (node.effective != node.documentVisible)
+        (node.effective ? psdData->sceneShownIds : psdData->sceneHiddenIds).insert(node.id);
+}
+
+void ensureVisibilityTree(PsdData* psdData) {
+    VisibilityTree& tree = psdData->visibility;
+    if (!tree.nodes.empty()) return;
+
+    const auto* model = psdData->widgetModel.get();
+    std::function<void(const QModelIndex&, int)> walk = [&](const QModelIndex& parent, int parentNode) {
+        for (int row = 0; row < model->rowCount(parent); ++row) {
+            const QModelIndex index = model->index(row, 0, parent);
+            const auto* item = model->layerItem(index);
+            addStat(&PsdStats::layersVisited);
+            if (!item) {
+                walk(index, parentNode);
+                continue;
+            }
+            VisibilityNode node;
+            node.id = static_cast<int>(item->id());
+            node.parent = parentNode;
+            node.documentVisible = item->isVisible();
+            node.effective = node.documentVisible && (parentNode < 0 || tree.nodes[parentNode].effective);
+            const int nodeIndex = int(tree.nodes.size());
+            tree.nodes.push_back(std::move(node));
+            tree.nodeById.insert(tree.nodes[nodeIndex].id, nodeIndex);
+            if (parentNode >= 0) tree.nodes[parentNode].children.push_back(nodeIndex);
+            updateSceneSets(psdData, tree.nodes[nodeIndex]);
+            walk(index, nodeIndex);
+        }
+    };
+    walk(QModelIndex(), -1);
+}
+
+// Recompute a node's effective visibility and, if it flipped, its subtree's
+static void propagateVisibility(PsdData* psdData, int nodeIndex, std::vector<LayerVisibility>* changed) {
+    VisibilityTree& tree = psdData->visibility;
+    VisibilityNode& node = tree.nodes[nodeIndex];
+    addStat(&PsdStats::layersVisited);
+    const bool own = node.ownOverride < 0 ? node.documentVisible : node.ownOverride > 0;
+    const bool effective = own && (node.parent < 0 || tree.nodes[node.parent].effective);
+    if (effective == node.effective) return;
+
+    node.effective = effective;
+    updateSceneSets(psdData, node);
+    if (changed) changed->push_back({ node.id, effective });
+    for (int child : node.children) {
+        propagateVisibility(psdData, child, changed);
+    }
+}
+
+void setOwnVisibility(PsdData* psdData, int layerId, int state, std::vector<LayerVisibility>* changed) {
+    ensureVisibilityTree(psdData);
+    const int nodeIndex = psdData->visibility.nodeById.value(layerId, -1);
+    if (nodeIndex < 0) return;
+    psdData->visibility.nodes[nodeIndex].ownOverride = state < 0 ? -1 : (state ? 1 : 0);
+    propagateVisibility(psdData, nodeIndex, changed);
+}
+
+void clearOwnVisibility(PsdData* psdData, std::vector<LayerVisibility>* changed) {
+    ensureVisibilityTree(psdData);
+    // Pre-order, so ancestors are settled before their descendants
+    for (int i = 0; i < int(psdData->visibility.nodes.size()); ++i) {
+        if (psdData->visibility.nodes[i].ownOverride < 0) continue;
+        psdData->visibility.nodes[i].ownOverride = -1;
+        propagateVisibility(psdData, i, changed);
+    }
+}
+
+// Append the layers whose effective visibility differs from before a run of
+// flips; a layer may flip more than once within one update
+static void netVisibilityChanges(PsdData* psdData, const std::vector<LayerVisibility>& flips,
+                                 std::vector<LayerVisibility>& changed) {
+    QHash<int, bool> before;
+    for (const LayerVisibility& flip : flips) {
+        if (!before.contains(flip.id)) before.insert(flip.id, !flip.visible);
+    }
+    for (const LayerVisibility& flip : flips) {
+        const auto it = before.find(flip.id);
+        if (it == before.end()) continue;
+        const bool now = psdData->visibility.nodes[psdData->visibility.nodeById.value(flip.id)].effective;
+        if (now != it.value()) changed.push_back({ flip.id, now });
+        before.erase(it);
+    }
+}
+
+bool setOwnVisibilityStates(PsdData* psdData, const quint8* states, qsizetype count,
+                            std::vector<LayerVisibility>* changed, std::string& error) {
+    ensureVisibilityTree(psdData);
+    std::vector<VisibilityNode>& nodes = psdData->visibility.nodes;
+    if (count != qsizetype(nodes.size())) {
+        error = "Visibility states cover " + std::to_string(count) + " layers, document has "
+            + std::to_string(nodes.size());
+        return false;
+    }
+    if (std::any_of(states, states + count, [](quint8 state) { return state > 2; })) {
+        error = "Invalid visibility state";
+        return false;
+    }
+    // Pre-order, so ancestors are settled before their descendants
+    std::vector<LayerVisibility> flips;
+    for (qsizetype i = 0; i < count; ++i) {
+        const qint8 ownOverride = qint8(states[i]) - 1;
+        if (nodes[i].ownOverride == ownOverride) continue;
+        nodes[i].ownOverride = ownOverride;
+        propagateVisibility(psdData, int(i), &flips);
+    }
+    if (changed) netVisibilityChanges(psdData, flips, *changed);
+    return true;
+}
+
+// ========== Hit testing ==========
+
+// Cells per side the grid aims for; layers are few per cell at this size
+static constexpr int LayerGridCells = 64;
+static constexpr int MinLayerGridCellSize = 16;
+
+static void ensureLayerGrid(PsdData* psdData) {
+    LayerGrid& grid = psdData->layerGrid;
+    if (grid.cellSize > 0) return;
+
+    ensureVisibilityTree(psdData);
+    const int longest = qMax(psdData->width, psdData->height);
+    grid.cellSize = qMax(MinLayerGridCellSize, (longest + LayerGridCells - 1) / LayerGridCells);
+    grid.columns = (psdData->width + grid.cellSize - 1) / grid.cellSize;
+    grid.rows = (psdData->height + grid.cellSize - 1) / grid.cellSize;
+    grid.cells.assign(size_t(grid.columns) * grid.rows, {});
+
+    // Tree nodes are in pre-order with the top row first, so leaves come
+    // out topmost first
+    const QRect canvas(0, 0, psdData->width, psdData->height);
+    const auto& nodes = psdData->visibility.nodes;
+    for (int i = 0; i < int(nodes.size()); ++i) {
+        if (!nodes[i].children.empty()) continue;
+        const QModelIndex index = findWidgetIndex(psdData, nodes[i].id);
+        const auto* item = index.isValid() ? psdData->widgetModel->layerItem(index) : nullptr;
+        if (!item || item->type() == QPsdAbstractLayerItem::Folder) continue;
+        const QRect rect = item->rect() & canvas;
+        if (rect.isEmpty()) continue;
+
+        const int entry = int(grid.entries.size());
+        grid.entries.push_back({ nodes[i].id, i, rect, item });
+        for (int row = rect.top() / grid.cellSize; row <= rect.bottom() / grid.cellSize; ++row) {
+            for (int column = rect.left() / grid.cellSize; column <= rect.right() / grid.cellSize; ++column) {
+                grid.cells[size_t(row) * grid.columns + column].push_back(entry);
+            }
+        }
+    }
+}
+
+const CoverageMask& coverageMask(PsdData* psdData, const QPsdAbstractLayerItem* item) {
+    auto it = psdData->coverageMasks.constFind(item);
+    if (it != psdData->coverageMasks.cend()) return it.value();
+
+    CoverageMask mask;
+    mask.rect = item->rect();
+    const QImage masked = applyMasks(item);
+    if (masked.isNull() || !masked.hasAlphaChannel()) {
+        // Nothing to read alpha from (e.g. no pixel data): the rect counts
+        mask.solid = true;
+    } else {
+        const QImage image = masked.convertToFormat(QImage::Format_ARGB32);
+        mask.rect.setSize(image.size());
+        mask.wordsPerRow = (image.width() + 63) / 64;
+        mask.bits.assign(size_t(mask.wordsPerRow) * image.height(), 0);
+        for (int y = 0; y < image.height(); ++y) {
+            const QRgb* line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+            quint64* row = mask.bits.data() + size_t(y) * mask.wordsPerRow;
+            for (int x = 0; x < image.width(); ++x) {
+                if (qAlpha(line[x])) row[x / 64] |= quint64(1) << (x % 64);
+            }
+        }
+    }
+    return psdData->coverageMasks.insert(item, std::move(mask)).value();
+}
+
+std::vector<int> hitTestLayers(PsdData* psdData, const QPoint& point, bool alpha, size_t limit) {
+    std::vector<int> hits;
+    if (point.x() < 0 || point.y() < 0 || point.x() >= psdData->width || point.y() >= psdData->height)
+        return hits;
+
+    ensureLayerGrid(psdData);
+    const LayerGrid& grid = psdData->layerGrid;
+    const auto& cell = grid.cells[size_t(point.y() / grid.cellSize) * grid.columns + point.x() / grid.cellSize];
+    for (int entryIndex : cell) {
+        const LayerGridEntry& entry = grid.entries[entryIndex];
+        addStat(&PsdStats::layersVisited);
+        if (!entry.rect.contains(point) || !psdData->visibility.nodes[entry.node].effective) continue;
+        if (alpha && !coverageMask(psdData, entry.item).covers(point)) continue;
+        hits.push_back(entry.id);
+        if (hits.size() == limit) break;
+    }
+    return hits;
+}
+
+int topmostCoveredLayer(PsdData* psdData, const QPoint& point) {
+    const std::vector<int> hits = hitTestLayers(psdData, point, true, 1);
+    return hits.empty() ? -1 : hits.front();
+}
+
+std::vector<int> queryLayerRegion(PsdData* psdData, const QRect& rect) {
+    std::vector<int> layers;
+    const QRect area = rect & QRect(0, 0, psdData->width, psdData->height);
+    if (area.isEmpty()) return layers;
+
+    ensureLayerGrid(psdData);
+    const LayerGrid& grid = psdData->layerGrid;
+    // Entries span several cells; collect each once, then restore z-order
+    std::vector<int> found;
+    std::vector<bool> seen(grid.entries.size());
+    for (int row = area.top() / grid.cellSize; row <= area.bottom() / grid.cellSize; ++row) {
+        for (int column = area.left() / grid.cellSize; column <= area.right() / grid.cellSize; ++column) {
+            for (int entryIndex : grid.cells[size_t(row) * grid.columns + column]) {
+                if (seen[entryIndex]) continue;
+                seen[entryIndex] = true;
+                const LayerGridEntry& entry = grid.entries[entryIndex];
+                addStat(&PsdStats::layersVisited);
+                if (entry.rect.intersects(area) && psdData->visibility.nodes[entry.node].effective)
+                    found.push_back(entryIndex);
+            }
+        }
+    }
+    std::sort(found.begin(), found.end());
+    layers.reserve(found.size());
+    for (int entryIndex : found) layers.push_back(grid.entries[entryIndex].id);
+    return layers;
+}
+
+// ========== Text updates ==========
+
+// Widget-model text layer whose runs can be replaced, or nullptr with error set
+static QPsdTextLayerItem* editableTextLayer(PsdData* psdData, int layerId, std::string& error) {
+    const QModelIndex index = findWidgetIndex(psdData, layerId);
+    if (!index.isValid()) {
+        error = "Layer not found";
+        return nullptr;
+    }
+
+    const auto* item = psdData->widgetModel->layerItem(index);
+    if (!item || item->type() != QPsdAbstractLayerItem::Text) {
+        error = "Layer is not a text layer";
+        return nullptr;
+    }
+
+    // const_cast: QPsdTextItem::paint() reads runs() live on every render,
+    // so mutating here is picked up by the next renderScene() call.
+    auto* textItem = const_cast<QPsdTextLayerItem*>(
+        static_cast<const QPsdTextLayerItem*>(item));
+    if (textItem->runs().isEmpty()) {
+        error = "Text layer has no runs";
+        return nullptr;
+    }
+    return textItem;
+}
+
+static quint64 mixHash(quint64 seed, quint64 value) {
+    // splitmix64 finalizer over the combined value
+    quint64 x = seed ^ (value + 0x9E3779B97F4A7C15ull + (seed << 6) + (seed >> 2));
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// Replace the runs with one run of the given text in the first run's style,
+// and update the document's text state.
+static void replaceText(PsdData* psdData, int layerId, QPsdTextLayerItem* textItem, const QString& text) {
+    QPsdTextLayerItem::Run newRun = textItem->runs().first();
+    newRun.text = text;
+    textItem->setRuns({ newRun });
+
+    quint64 textHash = mixHash(quint64(layerId), quint64(qHash(text)));
+    textHash = mixHash(textHash, quint64(text.size()));
+    psdData->textState ^= psdData->textHashes.value(layerId) ^ textHash;
+    psdData->textHashes.insert(layerId, textHash);
+}
+
+bool setTextLayerText(PsdData* psdData, int layerId, const QString& text, std::string& error) {
+    QPsdTextLayerItem* textItem = editableTextLayer(psdData, layerId, error);
+    if (!textItem) return false;
+    replaceText(psdData, layerId, textItem, text);
+    return true;
+}
+
+QRect textDirtyRect(PsdData* psdData, int layerId) {
+    const QRect canvas(0, 0, psdData->width, psdData->height);
+    const QModelIndex index = findWidgetIndex(psdData, layerId);
+    const auto* item = index.isValid() ? psdData->widgetModel->layerItem(index) : nullptr;
+    if (!item || !item->effects().isEmpty()) return canvas;
+    const QRect rect = item->rect();
+    return QRect(0, rect.top(), psdData->width, rect.height()) & canvas;
+}
+
+// ========== Layer image compositing helpers (ported from mcp-psd2x) ==========
+
+// Bounds of the visible children under parent; stores the result for every
+// folder on the way, so each node is visited once for the whole tree.
+static QRect collectSubtreeBounds(PsdData* psdData, const QModelIndex& parent) {
+    const auto* model = psdData->exporterModel.get();
+    QRect bounds;
+    for (int row = 0; row < model->rowCount(parent); ++row) {
+        auto index = model->index(row, 0, parent);
+        const auto* item = model->layerItem(index);
+        addStat(&PsdStats::layersVisited);
+        if (!item) continue;
+        if (item->type() == QPsdAbstractLayerItem::Folder) {
+            // Hidden folders are measured too: getLayerImage may target them
+            const QRect childBounds = collectSubtreeBounds(psdData, index);
+            psdData->subtreeBounds.insert(model->layerId(index), childBounds);
+            if (item->isVisible())
+                bounds = bounds.united(childBounds);
+        } else if (item->isVisible()) {
+            bounds = bounds.united(item->rect());
+        }
+    }
+    return bounds;
+}
+
+void ensureSubtreeBounds(PsdData* psdData) {
+    if (psdData->subtreeBoundsValid) return;
+    psdData->subtreeBounds.clear();
+    collectSubtreeBounds(psdData, QModelIndex());
+    psdData->subtreeBoundsValid = true;
+}
+
+QRect subtreeBounds(const PsdData* psdData, const QModelIndex& folder) {
+    return psdData->subtreeBounds.value(psdData->exporterModel->layerId(folder));
+}
+
+// ========== Occlusion culling ==========
+
+// Coverage regions stop growing past this many rectangles; a smaller
+// region only culls less, and keeps region operations cheap.
+static constexpr int MaxOccluderRects = 256;
+
+static bool alphaOpaque(const QImage& image) {
+    const QImage argb = image.convertToFormat(QImage::Format_ARGB32);
+    for (int y = 0; y < argb.height(); ++y) {
+        const QRgb* line = reinterpret_cast<const QRgb*>(argb.constScanLine(y));
+        for (int x = 0; x < argb.width(); ++x) {
+            if (qAlpha(line[x]) != 255) return false;
+        }
+    }
+    return true;
+}
+
+// True if the layer paints every pixel of its rect with alpha 255 (image
+// alpha or transparency mask, no layer mask). Layer pixels never change
+// after load, so the answer is cached per item.
+static bool isOpaqueLayer(PsdData* psdData, const QPsdAbstractLayerItem* item) {
+    const auto cached = psdData->opaqueLayers.constFind(item);
+    if (cached != psdData->opaqueLayers.cend()) return cached.value();
+
+    bool opaque = false;
+    const QImage image = item->image();
+    if (!image.isNull() && image.size() == item->rect().size() && item->layerMask().isNull()) {
+        const QImage transMask = item->transparencyMask();
+        if (image.hasAlphaChannel()) {
+            opaque = alphaOpaque(image);
+        } else if (transMask.isNull()) {
+            opaque = true;
+        } else if (transMask.width() >= image.width() && transMask.height() >= image.height()) {
+            opaque = true;
+            for (int y = 0; y < image.height() && opaque; ++y) {
+                const uchar* maskLine = transMask.constScanLine(y);
+                for (int x = 0; x < image.width(); ++x) {
+                    if (maskLine[x] != 255) { opaque = false; break; }
+                }
+            }
+        }
+    }
+    psdData->opaqueLayers.insert(item, opaque);
+    return opaque;
+}
+
+// Rect a raster or shape layer covers with opaque pixels when drawn at the
+// given painter opacity: Normal blend, full opacity and fill, not clipped to
+// a base and without raster or vector mask. Empty otherwise.
+// A clipped layer or folder only paints where its base does, a masked one
+// not at all where the mask is clear
+static bool isMaskedOrClipped(const QPsdAbstractLayerItem* item) {
+    return item->record().clipping() == QPsdLayerRecord::NonBase
+        || !item->layerMask().isNull()
+        || item->vectorMask().type != QPsdAbstractLayerItem::PathInfo::None;
+}
+
+static QRect occluderRect(PsdData* psdData, const QPsdAbstractLayerItem* item, qreal painterOpacity) {
+    if (painterOpacity < 1 || item->opacity() < 1 || item->fillOpacity() < 1) return QRect();
+    if (item->record().blendMode() != QPsdBlend::Normal) return QRect();
+    if (isMaskedOrClipped(item)) return QRect();
+    if (item->type() != QPsdAbstractLayerItem::Image && item->type() != QPsdAbstractLayerItem::Shape)
+        return QRect();
+    return isOpaqueLayer(psdData, item) ? item->rect() : QRect();
+}
+
+static QRegion folderOpaqueRegion(PsdData* psdData, const QModelIndex& folder);
+
+// Region a visible exporter layer or folder paints opaque onto its parent
+static QRegion layerOpaqueRegion(PsdData* psdData, const QModelIndex& index, qreal painterOpacity) {
+    const auto* item = psdData->exporterModel->layerItem(index);
+    if (!item || !item->isVisible() || painterOpacity < 1) return QRegion();
+    if (item->type() != QPsdAbstractLayerItem::Folder)
+        return occluderRect(psdData, item, painterOpacity);
+
+    // Pass-through children draw straight onto the parent (compositeChildren
+    // does not apply the folder opacity); isolated folders must be plain Normal.
+    if (isMaskedOrClipped(item)) return QRegion();
+    const auto blend = item->record().blendMode();
+    if (blend == QPsdBlend::PassThrough
+        || (blend == QPsdBlend::Normal && item->opacity() >= 1 && item->fillOpacity() >= 1))
+        return folderOpaqueRegion(psdData, index);
+    return QRegion();
+}
+
+static QRegion folderOpaqueRegion(PsdData* psdData, const QModelIndex& folder) {
+    const int id = psdData->exporterModel->layerId(folder);
+    const auto cached = psdData->folderOpaqueRegions.constFind(id);
+    if (cached != psdData->folderOpaqueRegions.cend()) return cached.value();
+
+    QRegion region;
+    const auto* model = psdData->exporterModel.get();
+    for (int row = 0; row < model->rowCount(folder) && region.rectCount() < MaxOccluderRects; ++row)
+        region += layerOpaqueRegion(psdData, model->index(row, 0, folder), 1);
+    psdData->folderOpaqueRegions.insert(id, region);
+    return region;
+}
+
+// ========== Content trimming ==========
+
+// Span regions with more rectangles than this are dropped (clipping to them
+// would cost more than blending the transparent pixels)
+static constexpr int MaxContentSpanRects = 64;
+
+// First and last column with non-zero alpha per row, -1 for empty rows.
+// Alpha comes from the image itself or, without an alpha channel, from
+// the transparency mask.
+static void scanAlphaRows(const QPsdAbstractLayerItem* item, const QImage& image,
+                          std::vector<std::pair<int, int>>& rows) {
+    rows.assign(image.height(), { -1, -1 });
+    const QImage transMask = item->transparencyMask();
+    if (image.hasAlphaChannel()) {
+        const QImage argb = image.convertToFormat(QImage::Format_ARGB32);
+        for (int y = 0; y < argb.height(); ++y) {
+            const QRgb* line = reinterpret_cast<const QRgb*>(argb.constScanLine(y));
+            int x0 = 0, x1 = argb.width() - 1;
+            while (x0 <= x1 && qAlpha(line[x0]) == 0) ++x0;
+            while (x1 > x0 && qAlpha(line[x1]) == 0) --x1;
+            if (x0 <= x1) rows[y] = { x0, x1 };
+        }
+    } else if (!transMask.isNull()) {
+        const int width = qMin(image.width(), transMask.width());
+        for (int y = 0; y < qMin(image.height(), transMask.height()); ++y) {
+            const uchar* line = transMask.constScanLine(y);
+            int x0 = 0, x1 = width - 1;
+            while (x0 <= x1 && line[x0] == 0) ++x0;
+            while (x1 > x0 && line[x1] == 0) --x1;
+            if (x0 <= x1) rows[y] = { x0, x1 };
+        }
+        // Pixels outside the mask keep the opaque image
+        for (int y = 0; y < image.height(); ++y) {
+            if (y >= transMask.height()) rows[y] = { 0, image.width() - 1 };
+            else if (width < image.width()) rows[y] = { rows[y].first < 0 ? width : rows[y].first, image.width() - 1 };
+        }
+    } else {
+        rows.assign(image.height(), { 0, image.width() - 1 });
+    }
+}
+
+const LayerContent& layerContent(PsdData* psdData, const QPsdAbstractLayerItem* item) {
+    auto it = psdData->layerContents.find(item);
+    if (it != psdData->layerContents.end()) return it.value();
+
+    LayerContent content;
+    const QImage image = item->image();
+    const QRect layerRect = item->rect();
+    if (!image.isNull()) {
+        std::vector<std::pair<int, int>> rows;
+        scanAlphaRows(item, image, rows);
+
+        QRect bounds;
+        for (int y = 0; y < int(rows.size()); ++y) {
+            if (rows[y].first < 0) continue;
+            bounds |= QRect(QPoint(rows[y].first, y), QPoint(rows[y].second, y));
+        }
+        bounds.translate(layerRect.topLeft());
+
+        // A layer mask that defaults to hidden limits content to the mask rect
+        if (!item->layerMask().isNull() && item->layerMaskDefaultColor() == 0)
+            bounds &= item->layerMaskRect();
+
+        if (!bounds.isEmpty()) {
+            QRegion spans;
+            for (int y = 0; y < int(rows.size()) && spans.rectCount() <= MaxContentSpanRects; ++y) {
+                if (rows[y].first < 0) continue;
+                spans += QRect(layerRect.x() + rows[y].first, layerRect.y() + y,
+                               rows[y].second - rows[y].first + 1, 1);
+            }
+            spans &= bounds;
+            // Worth clipping to only if it skips at least half the box
+            qint64 area = 0;
+            for (const QRect& r : spans) area += qint64(r.width()) * r.height();
+            if (spans.rectCount() <= MaxContentSpanRects && spans.rectCount() > 1
+                && area * 2 <= qint64(bounds.width()) * bounds.height())
+                content.spans = spans;
+        }
+        content.bounds = bounds;
+    }
+    return psdData->layerContents.insert(item, content).value();
+}
+
+// Apply transparency mask and raster layer mask to a layer's image
+QImage applyMasks(const QPsdAbstractLayerItem* item, const QRect& area) {
+    QImage image = item->image();
+    if (image.isNull()) return image;
+    // Offset of the processed part within the layer
+    QPoint offset;
+    if (!area.isEmpty() && area != image.rect()) {
+        image = image.copy(area);
+        offset = area.topLeft();
+    }
+
+    // Apply transparency mask for layers without built-in alpha
+    const QImage transMask = item->transparencyMask();
+    if (!transMask.isNull() && !image.hasAlphaChannel()) {
+        image = image.convertToFormat(QImage::Format_ARGB32);
+        for (int y = 0; y < qMin(image.height(), transMask.height() - offset.y()); ++y) {
+            QRgb* imgLine = reinterpret_cast<QRgb*>(image.scanLine(y));
+            const uchar* maskLine = transMask.constScanLine(y + offset.y()) + offset.x();
+            for (int x = 0; x < qMin(image.width(), transMask.width() - offset.x()); ++x) {
+                imgLine[x] = qRgba(qRed(imgLine[x]), qGreen(imgLine[x]),
+                                   qBlue(imgLine[x]), maskLine[x]);
+            }
+        }
+    }
+
+    // Apply raster layer mask if present
+    const QImage layerMask = item->layerMask();
+    if (!layerMask.isNull()) {
+        const QRect maskRect = item->layerMaskRect();
+        const QPoint layerOrigin = item->rect().topLeft() + offset;
+        const int defaultColor = item->layerMaskDefaultColor();
+
+        image = image.convertToFormat(QImage::Format_ARGB32);
+        for (int y = 0; y < image.height(); ++y) {
+            QRgb* scanLine = reinterpret_cast<QRgb*>(image.scanLine(y));
+            for (int x = 0; x < image.width(); ++x) {
+                const int maskX = (layerOrigin.x() + x) - maskRect.x();
+                const int maskY = (layerOrigin.y() + y) - maskRect.y();
+                int maskValue = defaultColor;
+                if (maskX >= 0 && maskX < layerMask.width() &&
+                    maskY >= 0 && maskY < layerMask.height()) {
+                    maskValue = qGray(layerMask.pixel(maskX, maskY));
+                }
+                const int alpha = qAlpha(scanLine[x]);
+                const int newAlpha = (alpha * maskValue) / 255;
+                scanLine[x] = qRgba(qRed(scanLine[x]), qGreen(scanLine[x]),
+                                    qBlue(scanLine[x]), newAlpha);
+            }
+        }
+    }
+
+    return image;
+}
+
+// The canvas a compositor painter draws on, when the layer's blend mode should
+// go through the software kernels instead of a QPainter composition mode.
+// Normal stays on QPainter, whose source-over path is already vectorized.
+static QImage* kernelTarget(QPainter& painter, QPsdBlend::Mode mode) {
+    if (mode == QPsdBlend::Normal || !hasBlendKernel(mode)) return nullptr;
+    QPaintDevice* device = painter.device();
+    if (!device || device->devType() != QInternal::Image) return nullptr;
+    auto* image = static_cast<QImage*>(device);
+    return image->format() == QImage::Format_ARGB32 ? image : nullptr;
+}
+
+// Recursively composite visible children onto the given painter
+void compositeChildren(PsdData* psdData,
+                       const QModelIndex& parent, QPainter& painter,
+                       const QPoint& origin, bool passThrough,
+                       const QRegion& coveredAbove) {
+    const auto* model = psdData->exporterModel.get();
+    const int count = model->rowCount(parent);
+
+    // Opaque coverage above each row, collected top-down before drawing
+    std::vector<QRegion> covered(count);
+    QRegion cover = coveredAbove;
+    for (int row = 0; row < count; ++row) {
+        covered[row] = cover;
+        if (cover.rectCount() < MaxOccluderRects)
+            cover += layerOpaqueRegion(psdData, model->index(row, 0, parent), painter.opacity());
+    }
+
+    // Bottom-to-top (last row = bottommost layer in PSD model)
+    for (int row = count - 1; row >= 0; --row) {
+        auto index = model->index(row, 0, parent);
+        const auto* item = model->layerItem(index);
+        addStat(&PsdStats::layersVisited);
+        if (!item || !item->isVisible()) continue;
+        const QRegion& above = covered[row];
+
+        if (item->type() == QPsdAbstractLayerItem::Folder) {
+            const auto folderBlend = item->record().blendMode();
+            const bool folderPassThrough = (folderBlend == QPsdBlend::PassThrough);
+
+            if (folderPassThrough) {
+                compositeChildren(psdData, index, painter, origin, true, above);
+            } else {
+                const QRect childBounds = subtreeBounds(psdData, index);
+                if (childBounds.isEmpty()) continue;
+                if (QRegion(childBounds).subtracted(above).isEmpty()) {
+                    addStat(&PsdStats::layersCulled);
+                    continue;
+                }
+
+                QImage groupCanvas(childBounds.size(), QImage::Format_ARGB32);
+                groupCanvas.fill(Qt::transparent);
+
+                // Pixels covered above are overwritten after the group is
+                // blended, so its children can be culled against them too
+                QPainter groupPainter(&groupCanvas);
+                compositeChildren(psdData, index, groupPainter, childBounds.topLeft(), false, above);
+                groupPainter.end();
+
+                const qreal opacity = painter.opacity() * item->opacity();
+                if (QImage* target = kernelTarget(painter, folderBlend)) {
+                    blendLayer(*target, childBounds.topLeft() - origin, groupCanvas, folderBlend, opacity,
+                               item->fillOpacity());
+                } else {
+                    painter.save();
+                    painter.setCompositionMode(QtPsdGui::compositionMode(folderBlend));
+                    painter.setOpacity(opacity * item->fillOpacity());
+                    painter.drawImage(childBounds.topLeft() - origin, groupCanvas);
+                    painter.restore();
+                }
+                addStat(&PsdStats::pixelsComposited, double(childBounds.width()) * childBounds.height());
+            }
+        } else {
+            // Only the part of the layer that has pixels and is not covered
+            const LayerContent& content = layerContent(psdData, item);
+            if (content.bounds.isEmpty()) continue;
+            QRegion visible = content.spans.isEmpty() ? QRegion(content.bounds) : content.spans;
+            visible -= above;
+            if (visible.isEmpty()) {
+                addStat(&PsdStats::layersCulled);
+                continue;
+            }
+            const QRect drawRect = visible.boundingRect();
+            QImage layerImage = applyMasks(item, drawRect.translated(-item->rect().topLeft()));
+            if (layerImage.isNull()) continue;
+
+            const auto blend = item->record().blendMode();
+            const qreal opacity = painter.opacity() * item->opacity();
+            if (QImage* target = kernelTarget(painter, blend)) {
+                blendLayer(*target, drawRect.topLeft() - origin, layerImage, blend, opacity,
+                           item->fillOpacity(), visible.translated(-origin));
+            } else {
+                painter.save();
+                if (visible.rectCount() > 1)
+                    painter.setClipRegion(visible.translated(-origin), Qt::IntersectClip);
+                painter.setCompositionMode(QtPsdGui::compositionMode(blend));
+                painter.setOpacity(opacity * item->fillOpacity());
+                painter.drawImage(drawRect.topLeft() - origin, layerImage);
+                painter.restore();
+            }
+            addStat(&PsdStats::pixelsComposited, double(layerImage.width()) * layerImage.height());
+        }
+    }
+}
+
+// ========== Entry point rendering ==========
+
+QImage compositeFolder(PsdData* psdData, const QModelIndex& index, QRect& bounds) {
+    const auto* model = psdData->exporterModel.get();
+    ensureSubtreeBounds(psdData);
+    bounds = subtreeBounds(psdData, index);
+    if (bounds.isEmpty()) return QImage();
+
+    QImage canvas(bounds.size(), QImage::Format_ARGB32);
+    canvas.fill(Qt::transparent);
+
+    QPainter painter(&canvas);
+    const auto blendMode = model->layerItem(index)->record().blendMode();
+    const bool passThrough = (blendMode == QPsdBlend::PassThrough);
+    compositeChildren(psdData, index, painter, bounds.topLeft(), passThrough);
+    painter.end();
+    return canvas;
+}
+
+// Scene items (leaf layers) completely covered by opaque layers above, given
+// the visibility overrides. Only plain raster/shape layers without effects
+// occlude; covered layers are culled unless they carry effects (which may
+// paint outside their rect), sit under an effects-bearing folder, or are
+// the base of a clipping group.
+static std::vector<quint32> occludedSceneItems(PsdData* psdData, const std::set<int>& hiddenIds,
+                                               const std::set<int>& shownIds) {
+    const auto* model = psdData->widgetModel.get();
+    std::vector<quint32> occluded;
+    QRegion cover;
+
+    auto effectiveVisible = [&](const QPsdAbstractLayerItem* item) {
+        const int id = static_cast<int>(item->id());
+        if (shownIds.count(id)) return true;
+        if (hiddenIds.count(id)) return false;
+        return item->isVisible();
+    };
+
+    // Rows top to bottom. occluding: every ancestor composites its content
+    // unchanged (Normal/pass-through, full opacity, no mask or clipping);
+    // plain: no ancestor effects.
+    std::function<void(const QModelIndex&, bool, bool)> walk =
+        [&](const QModelIndex& parent, bool occluding, bool plain) {
+        const int count = model->rowCount(parent);
+        for (int row = 0; row < count; ++row) {
+            const QModelIndex index = model->index(row, 0, parent);
+            const auto* item = model->layerItem(index);
+            addStat(&PsdStats::layersVisited);
+            if (!item || !effectiveVisible(item)) continue;
+
+            const bool hasEffects = !item->effects().isEmpty();
+            if (item->type() == QPsdAbstractLayerItem::Folder) {
+                const auto blend = item->record().blendMode();
+                const bool unchanged = (blend == QPsdBlend::PassThrough || blend == QPsdBlend::Normal)
+                    && item->opacity() >= 1 && item->fillOpacity() >= 1 && !isMaskedOrClipped(item);
+                walk(index, occluding && unchanged && !hasEffects, plain && !hasEffects);
+                continue;
+            }
+
+            bool clippingBase = false;
+            if (row > 0) {
+                const auto* above = model->layerItem(model->index(row - 1, 0, parent));
+                clippingBase = above && above->record().clipping() == QPsdLayerRecord::NonBase;
+            }
+            if (plain && !hasEffects && !clippingBase
+                && QRegion(item->rect()).subtracted(cover).isEmpty()) {
+                occluded.push_back(item->id());
+                continue;
+            }
+            if (occluding && !hasEffects && cover.rectCount() < MaxOccluderRects)
+                cover += occluderRect(psdData, item, 1);
+        }
+    };
+    walk(QModelIndex(), true, true);
+    return occluded;
+}
+
+// Paint the scene's visible items over image, which covers target
+static void paintScene(PsdData* psdData, QImage& image, const QRect& target) {
+    PhaseTimer timer("render.scene");
+    QPainter painter(&image);
+    if (target.topLeft() != QPoint(0, 0) || target.size() != QSize(psdData->width, psdData->height)) {
+        painter.translate(-target.topLeft());
+        painter.setClipRect(target);
+    }
+    psdData->scene->render(&painter);
+    painter.end();
+}
+
+// ========== Static/dynamic split ==========
+
+// Identifies a rendered state: visibility overrides plus text contents
+static quint64 compositeKey(const std::set<int>& hiddenIds, const std::set<int>& shownIds, quint64 textState) {
+    quint64 key = mixHash(textState, hiddenIds.size());
+    for (int id : hiddenIds) key = mixHash(key, quint32(id));
+    key = mixHash(key, shownIds.size());
+    for (int id : shownIds) key = mixHash(key, quint32(id));
+    return key;
+}
+
+void setDynamicLayers(PsdData* psdData, const std::set<int>& layerIds) {
+    psdData->dynamicLayerIds = layerIds;
+    psdData->layering = SceneLayering();
+}
+
+static void buildLayering(PsdData* psdData) {
+    SceneLayering& layering = psdData->layering;
+    const auto* model = psdData->widgetModel.get();
+    layering.leaves.clear();
+    layering.dynamicIds.clear();
+
+    // Rows top to bottom, so leaves come out top-first and are reversed below
+    std::function<void(const QModelIndex&, bool, quint32)> walk =
+        [&](const QModelIndex& parent, bool dynamic, quint32 group) {
+        for (int row = 0; row < model->rowCount(parent); ++row) {
+            const QModelIndex index = model->index(row, 0, parent);
+            const auto* item = model->layerItem(index);
+            addStat(&PsdStats::layersVisited);
+            if (!item) continue;
+            const int id = static_cast<int>(item->id());
+            const bool itemDynamic = dynamic || psdData->dynamicLayerIds.count(id);
+            if (itemDynamic) layering.dynamicIds.insert(id);
+
+            const auto blend = item->record().blendMode();
+            const bool noEffects = item->effects().isEmpty();
+            if (item->type() == QPsdAbstractLayerItem::Folder) {
+                const bool plainFolder = noEffects && item->opacity() >= 1 && item->fillOpacity() >= 1
+                    && (blend == QPsdBlend::PassThrough || blend == QPsdBlend::Normal);
+                walk(index, itemDynamic, group || plainFolder ? group : item->id());
+                continue;
+            }
+            layering.leaves.push_back({ item->id(), itemDynamic,
+                                        item->record().clipping() == QPsdLayerRecord::NonBase,
+                                        group == 0 && noEffects && blend == QPsdBlend::Normal, group });
+        }
+    };
+    walk(QModelIndex(), false, 0);
+    std::reverse(layering.leaves.begin(), layering.leaves.end());
+
+    const int count = int(layering.leaves.size());
+    int first = -1, last = -1;
+    for (int i = 0; i < count; ++i) {
+        if (!layering.leaves[i].dynamic) continue;
+        if (first < 0) first = i;
+        last = i;
+    }
+    if (first >= 0) {
+        // Keep clipping groups and isolated folders whole: the planes cannot
+        // split what is composited as a unit
+        const auto& leaves = layering.leaves;
+        auto joined = [&](int lower, int upper) {
+            return leaves[upper].clipped || (leaves[upper].group && leaves[upper].group == leaves[lower].group);
+        };
+        while (first > 0 && joined(first - 1, first)) --first;
+        while (last + 1 < count && joined(last, last + 1)) ++last;
+        // The upper plane is drawn source-over, which only matches leaves
+        // that are painted source-over themselves
+        for (int i = last + 1; i < count; ++i) {
+            if (!layering.leaves[i].plain) {
+                last = count - 1;
+                break;
+            }
+        }
+    }
+    layering.bandStart = first;
+    layering.bandEnd = last;
+    layering.valid = true;
+}
+
+// Text state without the dynamic layers' text (see setDynamicLayers())
+static quint64 staticTextState(PsdData* psdData) {
+    quint64 state = psdData->textState;
+    if (psdData->dynamicLayerIds.empty()) return state;
+    if (!psdData->layering.valid) buildLayering(psdData);
+    for (auto it = psdData->textHashes.cbegin(); it != psdData->textHashes.cend(); ++it) {
+        if (psdData->layering.dynamicIds.count(it.key())) state ^= it.value();
+    }
+    return state;
+}
+
+// Text hashes of the edited dynamic layers, by layer id
+static QHash<int, quint64> dynamicTextHashes(PsdData* psdData) {
+    QHash<int, quint64> hashes;
+    if (psdData->dynamicLayerIds.empty()) return hashes;
+    if (!psdData->layering.valid) buildLayering(psdData);
+    for (auto it = psdData->textHashes.cbegin(); it != psdData->textHashes.cend(); ++it) {
+        if (psdData->layering.dynamicIds.count(it.key())) hashes.insert(it.key(), it.value());
+    }
+    return hashes;
+}
+
+// Render target with the dynamic band painted over the cached lower plane
+// and the upper plane on top. Scene visibility must already be applied.
+static QImage renderLayered(PsdData* psdData, const std::set<int>& hiddenIds,
+                            const std::set<int>& shownIds, const QRect& target) {
+    SceneLayering& layering = psdData->layering;
+    const auto& leaves = layering.leaves;
+    const int count = int(leaves.size());
+
+    auto ownVisible = [&](quint32 id) {
+        if (shownIds.count(int(id))) return true;
+        if (hiddenIds.count(int(id))) return false;
+        const auto index = findWidgetIndex(psdData, int(id));
+        const auto* item = index.isValid() ? psdData->widgetModel->layerItem(index) : nullptr;
+        return item && item->isVisible();
+    };
+    // Paint only leaves [first, last] over image (covering rect)
+    auto paintRange = [&](QImage& image, const QRect& rect, int first, int last) {
+        std::vector<quint32> hidden;
+        for (int i = 0; i < count; ++i) {
+            if ((i >= first && i <= last) || !ownVisible(leaves[i].id)) continue;
+            psdData->scene->setItemVisible(leaves[i].id, false);
+            hidden.push_back(leaves[i].id);
+        }
+        paintScene(psdData, image, rect);
+        for (quint32 id : hidden) {
+            psdData->scene->setItemVisible(id, true);
+        }
+    };
+
+    // Planes depend on everything but the dynamic layers' visibility and text
+    auto isStatic = [&](int id) { return !layering.dynamicIds.count(id); };
+    std::set<int> staticHidden, staticShown;
+    std::copy_if(hiddenIds.begin(), hiddenIds.end(), std::inserter(staticHidden, staticHidden.end()), isStatic);
+    std::copy_if(shownIds.begin(), shownIds.end(), std::inserter(staticShown, staticShown.end()), isStatic);
+    const quint64 key = compositeKey(staticHidden, staticShown, staticTextState(psdData));
+
+    const QRect canvas(0, 0, psdData->width, psdData->height);
+    if (!layering.planesValid || layering.planesKey != key) {
+        PhaseTimer timer("render.planes");
+        layering.below = QImage(canvas.size(), QImage::Format_ARGB32_Premultiplied);
+        layering.below.fill(Qt::transparent);
+        if (layering.bandStart > 0)
+            paintRange(layering.below, canvas, 0, layering.bandStart - 1);
+        layering.above = QImage();
+        if (layering.bandEnd + 1 < count) {
+            layering.above = QImage(canvas.size(), QImage::Format_ARGB32_Premultiplied);
+            layering.above.fill(Qt::transparent);
+            paintRange(layering.above, canvas, layering.bandEnd + 1, count - 1);
+        }
+        layering.planesKey = key;
+        layering.planesValid = true;
+        addStat(&PsdStats::pixelsComposited, 2.0 * canvas.width() * canvas.height());
+    }
+
+    QImage image = layering.below.copy(target);
+    paintRange(image, target, layering.bandStart, layering.bandEnd);
+    if (!layering.above.isNull()) {
+        QPainter painter(&image);
+        painter.drawImage(QPoint(0, 0), layering.above, target);
+    }
+    addStat(&PsdStats::pixelsComposited, double(target.width()) * target.height());
+    return image;
+}
+
+static QImage renderScene(PsdData* psdData, const std::set<int>& hiddenIds, const std::set<int>& shownIds,
+                          const QRect& area, bool layered) {
+    // Remembered for partial re-renders with the same visibility
+    psdData->sceneHiddenIds = hiddenIds;
+    psdData->sceneShownIds = shownIds;
+
+    // Reset visibility to original state
+    std::function<void(const QModelIndex&)> resetVisibility = [&](const QModelIndex& parent) {
+        for (int row = 0; row < psdData->widgetModel->rowCount(parent); ++row) {
+            QModelIndex index = psdData->widgetModel->index(row, 0, parent);
+            const auto* layerItem = psdData->widgetModel->layerItem(index);
+            addStat(&PsdStats::layersVisited);
+            if (layerItem) {
+                quint32 layerId = layerItem->id();
+                bool originalVisible = layerItem->isVisible();
+                psdData->scene->setItemVisible(layerId, originalVisible);
+            }
+            resetVisibility(index);
+        }
+    };
+    resetVisibility(QModelIndex());
+
+    // Apply visibility overrides
+    for (int id : hiddenIds) {
+        psdData->scene->setItemVisible(static_cast<quint32>(id), false);
+    }
+    for (int id : shownIds) {
+        psdData->scene->setItemVisible(static_cast<quint32>(id), true);
+    }
+
+    const QRect canvas(0, 0, psdData->width, psdData->height);
+    const QRect target = area.isEmpty() ? canvas : area & canvas;
+
+    if (layered && !psdData->dynamicLayerIds.empty()) {
+        if (!psdData->layering.valid) buildLayering(psdData);
+        if (psdData->layering.bandStart >= 0)
+            return renderLayered(psdData, hiddenIds, shownIds, target);
+    }
+
+    // Hide layers that cannot show through for the duration of the render
+    const std::vector<quint32> occluded = occludedSceneItems(psdData, hiddenIds, shownIds);
+    for (quint32 id : occluded) {
+        psdData->scene->setItemVisible(id, false);
+    }
+    addStat(&PsdStats::layersCulled, double(occluded.size()));
+
+    // Render scene
+    QImage image(target.size(), QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    paintScene(psdData, image, target);
+    addStat(&PsdStats::pixelsComposited, double(target.width()) * target.height());
+
+    for (quint32 id : occluded) {
+        psdData->scene->setItemVisible(id, true);
+    }
+    return image;
+}
+
+QImage renderScene(PsdData* psdData, const std::set<int>& hiddenIds, const std::set<int>& shownIds,
+                   const QRect& area) {
+    return renderScene(psdData, hiddenIds, shownIds, area, true);
+}
+
+// ========== Composite cache ==========
+
+static void evictFrames(CompositeCache& cache) {
+    while (cache.bytes > cache.budget && !cache.entries.empty()) {
+        const CompositeCacheEntry& last = cache.entries.back();
+        cache.bytes -= last.frame.sizeInBytes();
+        cache.byKey.remove(last.key);
+        cache.entries.pop_back();
+    }
+}
+
+static QImage compositeFrame(PsdData* psdData, const std::set<int>& hiddenIds,
+                             const std::set<int>& shownIds, bool layered) {
+    CompositeCache& cache = psdData->compositeCache;
+    const quint64 textState = staticTextState(psdData);
+    const QHash<int, quint64> dynamicTexts = dynamicTextHashes(psdData);
+    const quint64 key = compositeKey(hiddenIds, shownIds, textState);
+
+    const auto found = cache.byKey.constFind(key);
+    if (found != cache.byKey.cend()) {
+        const auto entry = found.value();
+        if (entry->textState == textState && entry->hiddenIds == hiddenIds
+            && entry->shownIds == shownIds) {
+            addStat(&PsdStats::frameCacheHits);
+            cache.entries.splice(cache.entries.begin(), cache.entries, entry);
+            QRegion dirty;
+            for (auto it = dynamicTexts.cbegin(); it != dynamicTexts.cend(); ++it) {
+                if (entry->dynamicTexts.value(it.key()) != it.value())
+                    dirty |= textDirtyRect(psdData, it.key());
+            }
+            for (auto it = entry->dynamicTexts.cbegin(); it != entry->dynamicTexts.cend(); ++it) {
+                if (!dynamicTexts.contains(it.key()))
+                    dirty |= textDirtyRect(psdData, it.key());
+            }
+            if (dirty.isEmpty()) {
+                // The scene is not touched; later partial renders re-apply these
+                psdData->sceneHiddenIds = hiddenIds;
+                psdData->sceneShownIds = shownIds;
+                return entry->frame;
+            }
+            // Dynamic text moved on since the frame was cached: repaint its rows
+            QPainter painter(&entry->frame);
+            painter.setCompositionMode(QPainter::CompositionMode_Source);
+            for (const QRect& rect : dirty) {
+                const QImage part = renderScene(psdData, hiddenIds, shownIds, rect, layered);
+                painter.drawImage(rect.topLeft(), part.convertToFormat(QImage::Format_RGBA8888));
+            }
+            painter.end();
+            entry->dynamicTexts = dynamicTexts;
+            return entry->frame;
+        }
+    }
+    addStat(&PsdStats::frameCacheMisses);
+
+    QImage frame = renderScene(psdData, hiddenIds, shownIds, QRect(), layered);
+    {
+        PhaseTimer timer("render.convert");
+        frame = std::move(frame).convertToFormat(QImage::Format_RGBA8888);
+    }
+    if (frame.sizeInBytes() <= cache.budget) {
+        if (found != cache.byKey.cend()) {
+            // Hash collision with a different state: replace that entry
+            cache.bytes -= found.value()->frame.sizeInBytes();
+            cache.entries.erase(found.value());
+        }
+        cache.entries.push_front({ key, hiddenIds, shownIds, textState, dynamicTexts, frame });
+        cache.byKey.insert(key, cache.entries.begin());
+        cache.bytes += frame.sizeInBytes();
+        evictFrames(cache);
+    }
+    return frame;
+}
+
+QImage compositeFrame(PsdData* psdData, const std::set<int>& hiddenIds, const std::set<int>& shownIds) {
+    return compositeFrame(psdData, hiddenIds, shownIds, true);
+}
+
+void prerenderFrame(PsdData* psdData, const std::set<int>& hiddenIds, const std::set<int>& shownIds) {
+    std::set<int> sceneHidden = psdData->sceneHiddenIds;
+    std::set<int> sceneShown = psdData->sceneShownIds;
+    // Render on the non-layered path: the static planes belong to the
+    // current state and would otherwise be rebuilt for the speculative one
+    compositeFrame(psdData, hiddenIds, shownIds, false);
+    psdData->sceneHiddenIds = std::move(sceneHidden);
+    psdData->sceneShownIds = std::move(sceneShown);
+}
+
+void setCompositeCacheBudget(PsdData* psdData, qsizetype bytes) {
+    psdData->compositeCache.budget = std::max<qsizetype>(bytes, 0);
+    evictFrames(psdData->compositeCache);
+}
+
+void prerenderVisibility(PsdData* psdData, const std::vector<LayerVisibility>& overrides) {
+    ensureVisibilityTree(psdData);
+    VisibilityTree& tree = psdData->visibility;
+    std::vector<std::pair<int, qint8>> saved;
+    for (const LayerVisibility& layer : overrides) {
+        const int nodeIndex = tree.nodeById.value(layer.id, -1);
+        if (nodeIndex < 0) continue;
+        saved.push_back({ layer.id, tree.nodes[nodeIndex].ownOverride });
+        setOwnVisibility(psdData, layer.id, layer.visible ? 1 : 0);
+    }
+    const std::set<int> hiddenIds = psdData->sceneHiddenIds;
+    const std::set<int> shownIds = psdData->sceneShownIds;
+    for (auto it = saved.rbegin(); it != saved.rend(); ++it) {
+        setOwnVisibility(psdData, it->first, it->second);
+    }
+    prerenderFrame(psdData, hiddenIds, shownIds);
+}
+
+void clearCompositeCache(PsdData* psdData) {
+    CompositeCache& cache = psdData->compositeCache;
+    cache.entries.clear();
+    cache.byKey.clear();
+    cache.bytes = 0;
+    // The static planes are finished frames too
+    psdData->layering.planesValid = false;
+    psdData->layering.below = QImage();
+    psdData->layering.above = QImage();
+}
+
+// ========== State deltas ==========
+
+// Binary state delta for applyAndRender, little-endian int32 words:
+//
+//   int32 header[2]   magic 'PSRD', version
+//   records, each an op word followed by its operands:
+//     0 resetVisibility                  drop all visibility overrides
+//     1 setVisible   id, visible (0/1)   override one layer's own visibility
+//     2 clearVisible id                  drop one layer's override
+//     3 setText      id, byteLength, UTF-8 bytes zero-padded to 4
+//     4 setOpacity   id, float32         reserved, rejected
+//
+// Visibility records are own-visibility overrides on the visibility tree;
+// effective visibility (folders hide their contents) follows in the module.
+// Ids the document does not have are ignored.
+enum StateDeltaOp {
+    OpResetVisibility, OpSetVisible, OpClearVisible, OpSetText, OpSetOpacity
+};
+
+static constexpr qint32 StateDeltaMagic = 0x44525350; // "PSRD"
+static constexpr qint32 StateDeltaVersion = 2;
+
+bool applyStateDelta(PsdData* psdData, const char* data, qsizetype size, QRect& dirty,
+                     std::vector<LayerVisibility>& visibilityChanged, std::string& error) {
+    const qsizetype words = size / 4;
+    qsizetype pos = 0;
+    auto readWord = [&](qint32& value) {
+        if (pos >= words) return false;
+        std::memcpy(&value, data + pos * 4, 4);
+        ++pos;
+        return true;
+    };
+
+    qint32 magic = 0, version = 0;
+    if (size % 4 != 0 || !readWord(magic) || !readWord(version)
+        || magic != StateDeltaMagic || version != StateDeltaVersion) {
+        error = "Invalid state delta header";
+        return false;
+    }
+
+    // Validate everything into a plan first; nothing is touched on error
+    struct PendingVisibility {
+        qint32 op;
+        int id;
+        int state;
+    };
+    std::vector<PendingVisibility> visibility;
+    struct PendingText {
+        int id;
+        QPsdTextLayerItem* item;
+        QString text;
+    };
+    std::vector<PendingText> texts;
+    auto truncated = [&] {
+        error = "Truncated state delta";
+        return false;
+    };
+    while (pos < words) {
+        qint32 op = 0, id = 0;
+        readWord(op);
+        switch (op) {
+        case OpResetVisibility:
+            visibility.push_back({ op, 0, -1 });
+            break;
+        case OpSetVisible: {
+            qint32 visible = 0;
+            if (!readWord(id) || !readWord(visible)) return truncated();
+            visibility.push_back({ op, id, visible ? 1 : 0 });
+            break;
+        }
+        case OpClearVisible:
+            if (!readWord(id)) return truncated();
+            visibility.push_back({ op, id, -1 });
+            break;
+        case OpSetText: {
+            qint32 length = 0;
+            if (!readWord(id) || !readWord(length)) return truncated();
+            const qsizetype padded = (qsizetype(length) + 3) / 4;
+            if (length < 0 || padded > words - pos) return truncated();
+            QPsdTextLayerItem* textItem = editableTextLayer(psdData, id, error);
+            if (!textItem) {
+                error += " (layer " + std::to_string(id) + ")";
+                return false;
+            }
+            texts.push_back({ id, textItem, QString::fromUtf8(data + pos * 4, length) });
+            pos += padded;
+            break;
+        }
+        case OpSetOpacity:
+            error = "Opacity changes are not supported by the scene renderer";
+            return false;
+        default:
+            error = "Unknown state delta op " + std::to_string(op);
+            return false;
+        }
+    }
+
+    // Apply
+    std::vector<LayerVisibility> flips;
+    for (const PendingVisibility& pending : visibility) {
+        if (pending.op == OpResetVisibility)
+            clearOwnVisibility(psdData, &flips);
+        else
+            setOwnVisibility(psdData, pending.id, pending.state, &flips);
+    }
+    visibilityChanged.clear();
+    netVisibilityChanges(psdData, flips, visibilityChanged);
+
+    const QRect canvas(0, 0, psdData->width, psdData->height);
+    dirty = visibilityChanged.empty() ? QRect() : canvas;
+    for (const PendingText& pending : texts) {
+        replaceText(psdData, pending.id, pending.item, pending.text);
+        dirty |= textDirtyRect(psdData, pending.id);
+    }
+    return true;
+}
+
+// ========== Layer table ==========
+
+// Binary layer table: one row per layer plus a groupEnd row after each
+// group's children, in the same order as parsePsd's layers array.
+//
+//   int32 header[4]   magic 'PSRL', version, rowCount, stringPoolSize
+//   int32 columns[13][rowCount]
+//       id, index, x, y, width, height, flags, opacity, blendMode,
+//       nameOffset, nameLength, textOffset, textLength
+//   uint8 stringPool[stringPoolSize]   UTF-8, addressed by offset/length
+//
+// flags: bits 0-1 row type (0 layer, 1 group, 2 groupEnd), bit 2 visible,
+// bits 3-5 itemType (0 unknown, 1 text, 2 shape, 3 image, 4 folder).
+// textOffset is -1 for layers without text. Groups without bounds of their
+// own carry the union of their descendants' bounds, for layout.
+enum LayerTableColumn {
+    ColId, ColIndex, ColX, ColY, ColWidth, ColHeight, ColFlags, ColOpacity,
+    ColBlendMode, ColNameOffset, ColNameLength, ColTextOffset, ColTextLength,
+    LayerTableColumnCount
+};
+
+static constexpr qint32 LayerTableMagic = 0x4C525350; // "PSRL"
+static constexpr qint32 LayerTableVersion = 1;
+
+static int itemTypeOrdinal(QPsdAbstractLayerItem::Type type) {
+    switch (type) {
+        case QPsdAbstractLayerItem::Text: return 1;
+        case QPsdAbstractLayerItem::Shape: return 2;
+        case QPsdAbstractLayerItem::Image: return 3;
+        case QPsdAbstractLayerItem::Folder: return 4;
+        default: return 0;
+    }
+}
+
+void buildLayerTable(PsdData* psdData) {
+    PhaseTimer timer("parse.layerTable");
+    const auto* model = psdData->widgetModel.get();
+    std::vector<std::array<qint32, LayerTableColumnCount>> rows;
+    QByteArray pool;
+
+    auto appendString = [&](const QString& str, qint32& offset, qint32& length) {
+        const QByteArray utf8 = str.toUtf8();
+        offset = pool.size();
+        length = utf8.size();
+        pool.append(utf8);
+    };
+
+    // Returns the union of the non-empty rects below parent
+    std::function<QRect(const QModelIndex&)> traverse = [&](const QModelIndex& parent) {
+        QRect descendants;
+        for (int row = 0; row < model->rowCount(parent); ++row) {
+            const QModelIndex index = model->index(row, 0, parent);
+            const bool isGroup = model->hasChildren(index);
+            std::array<qint32, LayerTableColumnCount> r {};
+            r[ColId] = model->layerId(index);
+            r[ColIndex] = row;
+            r[ColBlendMode] = 1;
+            r[ColTextOffset] = -1;
+            appendString(model->layerName(index), r[ColNameOffset], r[ColNameLength]);
+
+            const auto* item = model->layerItem(index);
+            if (item) {
+                const QRect rect = item->rect();
+                r[ColX] = rect.x();
+                r[ColY] = rect.y();
+                r[ColWidth] = rect.width();
+                r[ColHeight] = rect.height();
+                r[ColFlags] = (isGroup ? 1 : 0)
+                    | (item->isVisible() ? 1 << 2 : 0)
+                    | (itemTypeOrdinal(item->type()) << 3);
+                r[ColOpacity] = static_cast<int>(item->opacity() * 255);
+                r[ColBlendMode] = blendModeOrdinal(item->record().blendMode());
+
+                if (item->type() == QPsdAbstractLayerItem::Text) {
+                    const auto* textItem = static_cast<const QPsdTextLayerItem*>(item);
+                    QString fullText;
+                    for (const auto& run : textItem->runs()) {
+                        fullText += run.text;
+                    }
+                    appendString(fullText, r[ColTextOffset], r[ColTextLength]);
+                }
+            } else if (isGroup) {
+                r[ColFlags] = 1;
+            }
+            rows.push_back(r);
+            if (r[ColWidth] > 0 && r[ColHeight] > 0)
+                descendants = descendants.united(QRect(r[ColX], r[ColY], r[ColWidth], r[ColHeight]));
+
+            if (isGroup) {
+                const size_t groupRow = rows.size() - 1;
+                const QRect childBounds = traverse(index);
+                auto& g = rows[groupRow];
+                if ((g[ColWidth] <= 0 || g[ColHeight] <= 0) && !childBounds.isEmpty()) {
+                    g[ColX] = childBounds.x();
+                    g[ColY] = childBounds.y();
+                    g[ColWidth] = childBounds.width();
+                    g[ColHeight] = childBounds.height();
+                }
+                descendants = descendants.united(childBounds);
+                std::array<qint32, LayerTableColumnCount> end {};
+                end[ColId] = r[ColId];
+                end[ColFlags] = 2;
+                end[ColBlendMode] = 1;
+                end[ColTextOffset] = -1;
+                rows.push_back(end);
+            }
+        }
+        return descendants;
+    };
+    traverse(QModelIndex());
+
+    const qint32 rowCount = static_cast<qint32>(rows.size());
+    const qsizetype columnsBytes = qsizetype(LayerTableColumnCount) * rowCount * sizeof(qint32);
+    QByteArray& table = psdData->layerTable;
+    table.resize(4 * sizeof(qint32) + columnsBytes + pool.size());
+
+    auto* header = reinterpret_cast<qint32*>(table.data());
+    header[0] = LayerTableMagic;
+    header[1] = LayerTableVersion;
+    header[2] = rowCount;
+    header[3] = pool.size();
+
+    qint32* columns = header + 4;
+    for (int c = 0; c < LayerTableColumnCount; ++c) {
+        qint32* column = columns + qsizetype(c) * rowCount;
+        for (qint32 i = 0; i < rowCount; ++i) {
+            column[i] = rows[i][c];
+        }
+    }
+    memcpy(table.data() + 4 * sizeof(qint32) + columnsBytes, pool.constData(), pool.size());
+}
+
+// ========== Layer JSON export ==========
+
+void JsonWriter::value(double d) {
+    separate();
+    if (std::isfinite(d))
+        m_out.append(QByteArray::number(d, 'g', QLocale::FloatingPointShortest));
+    else
+        m_out.append("null");
+}
+
+void JsonWriter::writeString(const QString& str) {
+    m_out.append('"');
+    const QByteArray utf8 = str.toUtf8();
+    qsizetype plainStart = 0;
+    for (qsizetype i = 0; i < utf8.size(); ++i) {
+        const uchar c = static_cast<uchar>(utf8[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        m_out.append(utf8.constData() + plainStart, i - plainStart);
+        plainStart = i + 1;
+        switch (c) {
+            case '"': m_out.append("\\\""); break;
+            case '\\': m_out.append("\\\\"); break;
+            case '\n': m_out.append("\\n"); break;
+            case '\r': m_out.append("\\r"); break;
+            case '\t': m_out.append("\\t"); break;
+            case '\b': m_out.append("\\b"); break;
+            case '\f': m_out.append("\\f"); break;
+            default: {
+                char escaped[7];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                m_out.append(escaped);
+            }
+        }
+    }
+    m_out.append(utf8.constData() + plainStart, utf8.size() - plainStart);
+    m_out.append('"');
+}
+
+void writeLayerJson(JsonWriter& writer, const PsdData* psdData,
+                    const QModelIndex& index, int depth, int maxDepth, int fields) {
+    const auto* model = psdData->exporterModel.get();
+    const int layerId = model->layerId(index);
+    addStat(&PsdStats::layersVisited);
+
+    // Keys are written in sorted order, as the QJsonObject export did
+    const auto* item = model->layerItem(index);
+    auto is = [&](QPsdAbstractLayerItem::Type type, int field) {
+        return item && item->type() == type && (fields & field);
+    };
+    const auto* shape = is(QPsdAbstractLayerItem::Shape, JsonShape)
+        ? static_cast<const QPsdShapeLayerItem*>(item) : nullptr;
+    const auto* folder = is(QPsdAbstractLayerItem::Folder, JsonFolder)
+        ? static_cast<const QPsdFolderLayerItem*>(item) : nullptr;
+    const auto* text = is(QPsdAbstractLayerItem::Text, JsonText)
+        ? static_cast<const QPsdTextLayerItem*>(item) : nullptr;
+    const bool opacity = item && (fields & JsonOpacity);
+    const auto pathInfo = shape ? shape->pathInfo() : QPsdAbstractLayerItem::PathInfo();
+    const int childCount = model->rowCount(index);
+
+    writer.beginObject();
+    if (shape)
+        writer.field("brushColor", shape->brush().color().name());
+    if (folder)
+        writer.field("childCount", childCount);
+    if (childCount > 0 && (maxDepth < 0 || depth < maxDepth)) {
+        writer.key("children");
+        writer.beginArray();
+        for (int row = 0; row < childCount; ++row)
+            writeLayerJson(writer, psdData, model->index(row, 0, index), depth + 1, maxDepth, fields);
+        writer.endArray();
+    }
+    if (shape && pathInfo.type == QPsdAbstractLayerItem::PathInfo::RoundedRectangle)
+        writer.field("cornerRadius", double(pathInfo.radius));
+    if (opacity)
+        writer.field("fillOpacity", double(item->fillOpacity()));
+    if (fields & JsonHint) {
+        const auto layerHint = model->layerHint(index);
+        if (!layerHint.properties.isEmpty()) {
+            writer.key("hintProperties");
+            writer.beginArray();
+            for (const auto& prop : layerHint.properties)
+                writer.value(prop);
+            writer.endArray();
+        }
+        static const char* hintNames[] = {"embed", "merge", "custom", "native", "skip", "none"};
+        writer.field("hintType", hintNames[layerHint.type]);
+        writer.field("hintVisible", layerHint.visible);
+    }
+    if (folder)
+        writer.field("isOpened", folder->isOpened());
+    writer.field("layerId", layerId);
+    if (is(QPsdAbstractLayerItem::Image, JsonImage)) {
+        const auto lf = item->linkedFile();
+        if (!lf.name.isEmpty())
+            writer.field("linkedFile", lf.name);
+    }
+    writer.field("name", model->layerName(index));
+    if (opacity)
+        writer.field("opacity", double(item->opacity()));
+    if (shape) {
+        static const char* pathTypes[] = {"none", "rectangle", "roundedRectangle", "path"};
+        writer.field("pathType", pathTypes[pathInfo.type]);
+    }
+    if (item && (fields & JsonRect)) {
+        const auto r = model->rect(index);
+        writer.key("rect");
+        writer.beginObject();
+        writer.field("height", r.height());
+        writer.field("width", r.width());
+        writer.field("x", r.x());
+        writer.field("y", r.y());
+        writer.endObject();
+    }
+    if (text) {
+        writer.key("runs");
+        writer.beginArray();
+        for (const auto& run : text->runs()) {
+            writer.beginObject();
+            writer.field("color", run.color.name());
+            writer.field("font", run.font.family());
+            writer.field("fontSize", run.font.pointSizeF());
+            writer.field("originalFont", run.originalFontName);
+            writer.field("text", run.text);
+            writer.endObject();
+        }
+        writer.endArray();
+    }
+    if (item)
+        writer.field("type", itemTypeToString(item->type()).c_str());
+    if (fields & JsonVersion)
+        writer.field("version", static_cast<double>(psdData->layerVersions.value(layerId)));
+    if (item && (fields & JsonVisible))
+        writer.field("visible", item->isVisible());
+    writer.endObject();
+}
+
+bool writeDocumentJson(PsdData* psdData, QByteArray& out, int rootLayerId, int maxDepth, int fields) {
+    const auto* model = psdData->exporterModel.get();
+
+    QModelIndex root;
+    if (rootLayerId >= 0) {
+        root = findExporterIndex(psdData, rootLayerId);
+        if (!root.isValid()) return false;
+    }
+
+    out.resize(0);
+    JsonWriter writer(out);
+    writer.beginObject();
+    writer.field("height", psdData->height);
+    writer.key("layers");
+    writer.beginArray();
+    if (root.isValid()) {
+        writeLayerJson(writer, psdData, root, 0, maxDepth, fields);
+    } else {
+        for (int row = 0; row < model->rowCount(); ++row)
+            writeLayerJson(writer, psdData, model->index(row, 0), 0, maxDepth, fields);
+    }
+    writer.endArray();
+    if (fields & JsonVersion)
+        writer.field("version", static_cast<double>(psdData->version));
+    writer.field("width", psdData->width);
+    writer.endObject();
+    return true;
+}
+
+// ========== Export hints ==========
+
+QByteArray hintsToJson(PsdData* psdData) {
+    // Traverse all layers, collect non-default hints
+    QJsonObject layerHints;
+    std::function<void(const QModelIndex&)> traverse = [&](const QModelIndex& parent) {
+        for (int row = 0; row < psdData->exporterModel->rowCount(parent); ++row) {
+            auto index = psdData->exporterModel->index(row, 0, parent);
+            const auto* item = psdData->exporterModel->layerItem(index);
+            addStat(&PsdStats::layersVisited);
+            if (!item) continue;
+
+            const auto hint = psdData->exporterModel->layerHint(index);
+            if (!hint.isDefaultValue()) {
+                QJsonObject hintObj;
+                if (!hint.id.isEmpty()) hintObj["id"] = hint.id;
+                hintObj["type"] = static_cast<int>(hint.type);
+                if (!hint.componentName.isEmpty()) hintObj["name"] = hint.componentName;
+                hintObj["native"] = static_cast<int>(hint.baseElement);
+                hintObj["visible"] = hint.visible;
+                if (!hint.properties.isEmpty()) {
+                    QStringList propList = hint.properties.values();
+                    std::sort(propList.begin(), propList.end());
+                    hintObj["properties"] = QJsonArray::fromStringList(propList);
+                }
+                layerHints[QString::number(item->id())] = hintObj;
+            }
+            traverse(index);
+        }
+    };
+    traverse(QModelIndex());
+
+    QJsonObject root;
+    root["qtpsdparser.hint"] = 1;
+    root["layers"] = layerHints;
+
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+int hintsFromJson(PsdData* psdData, const QByteArray& json) {
+    QJsonDocument doc = QJsonDocument::fromJson(json);
+    if (doc.isNull()) return -1;
+
+    QJsonObject root = doc.object();
+    QJsonObject layerHintsJson = root["layers"].toObject();
+
+    int restored = 0;
+    for (const auto& idStr : layerHintsJson.keys()) {
+        int layerId = idStr.toInt();
+        QModelIndex index = findExporterIndex(psdData, layerId);
+        if (!index.isValid()) continue;
+
+        QVariantMap settings = layerHintsJson[idStr].toObject().toVariantMap();
+        QStringList properties = settings.value("properties").toStringList();
+
+        QPsdExporterTreeItemModel::ExportHint hint;
+        hint.id = settings.value("id").toString();
+        hint.type = static_cast<QPsdExporterTreeItemModel::ExportHint::Type>(settings.value("type").toInt());
+        hint.componentName = settings.value("name").toString();
+        hint.baseElement = static_cast<QPsdExporterTreeItemModel::ExportHint::NativeComponent>(settings.value("native").toInt());
+        hint.visible = settings.value("visible").toBool();
+        hint.properties = QSet<QString>(properties.begin(), properties.end());
+
+        psdData->exporterModel->setLayerHint(index, hint);
+        markLayerChanged(psdData, layerId);
+        restored++;
+    }
+    return restored;
+}
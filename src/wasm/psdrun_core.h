@@ -0,0 +1,495 @@
+// Copyright (C) 2026 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+//
+// PSD Run document core - loading, compositing, layer table and JSON export
+// without any emscripten dependency, shared by the WASM module
+// (psdrun_qt.cpp) and the native benchmarks (bench/psdrun_bench.cpp).
+
+#ifndef PSDRUN_CORE_H
+#define PSDRUN_CORE_H
+
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QPersistentModelIndex>
+#include <QtCore/QRect>
+#include <QtCore/QString>
+#include <QtGui/QImage>
+#include <QtGui/QRegion>
+
+#include <QtPsdCore/qpsdblend.h>
+#include <QtPsdGui/QPsdAbstractLayerItem>
+#include <QtPsdGui/QPsdGuiLayerTreeItemModel>
+#include <QtPsdWidget/QPsdWidgetTreeItemModel>
+#include <QtPsdWidget/QPsdScene>
+#include <QtPsdExporter/QPsdExporterTreeItemModel>
+
+class QPainter;
+
+// Milliseconds on a monotonic clock; performance.now() in the browser
+double nowMs();
+
+// ========== Startup / phase timing ==========
+
+struct PhaseTiming {
+    std::string name;
+    double start;
+    double duration;
+};
+
+// Most recent phases, oldest first (bounded)
+std::vector<PhaseTiming>& phaseTimings();
+
+class PhaseTimer {
+public:
+    explicit PhaseTimer(const char* name) : m_name(name), m_start(nowMs()) {}
+    ~PhaseTimer();
+
+private:
+    const char* m_name;
+    double m_start;
+};
+
+// ========== Per-call profiling counters ==========
+
+// Entry points tracked by getStats(); names in statEntryNames
+enum StatEntry {
+    StatParse, StatRender, StatLayerImage, StatExportJson, StatHints, StatSetText,
+    StatTextUpdates, StatApplyAndRender, StatPrerender, StatHitTest,
+    StatEntryCount
+};
+inline constexpr const char* statEntryNames[StatEntryCount] = {
+    "parsePsd", "renderCompositeWithQt", "getLayerImage", "exportLayerJson",
+    "hints", "setLayerText", "applyTextUpdates", "applyAndRender", "prerenderComposite",
+    "hitTest"
+};
+
+struct CallStats {
+    double count = 0;
+    double totalMs = 0;
+    double maxMs = 0;
+};
+
+struct PsdStats {
+    CallStats calls[StatEntryCount];
+    double bytesCopied = 0;       // bytes handed across the JS boundary
+    double pixelsComposited = 0;  // pixels drawn by the scene or compositor
+    double cacheHits = 0;
+    double cacheMisses = 0;
+    double layersVisited = 0;     // tree nodes touched by walks and lookups
+    double layersCulled = 0;      // layers skipped as covered by opaque layers above
+    double frameCacheHits = 0;    // full frames served from the composite cache
+    double frameCacheMisses = 0;
+};
+
+// Opt-in; when disabled the counters cost a null check per event
+extern bool g_statsEnabled;
+// Counters of the document the current entry point is working on
+extern PsdStats* g_currentStats;
+
+inline void addStat(double PsdStats::*counter, double amount = 1) {
+    if (g_currentStats) g_currentStats->*counter += amount;
+}
+
+// Scoped to one entry point call: routes addStat() to the document's counters
+// and records the call duration.
+class CallTimer {
+public:
+    CallTimer(PsdStats& stats, StatEntry entry)
+        : m_stats(g_statsEnabled ? &stats : nullptr), m_entry(entry),
+          m_start(m_stats ? nowMs() : 0) {
+        g_currentStats = m_stats;
+    }
+    ~CallTimer() {
+        g_currentStats = nullptr;
+        if (!m_stats) return;
+        const double elapsed = nowMs() - m_start;
+        CallStats& call = m_stats->calls[m_entry];
+        call.count++;
+        call.totalMs += elapsed;
+        call.maxMs = std::max(call.maxMs, elapsed);
+    }
+
+private:
+    PsdStats* m_stats;
+    StatEntry m_entry;
+    double m_start;
+};
+
+// ========== Document ==========
+
+// Where a layer actually has pixels, found from its alpha once per layer.
+// bounds is in canvas coordinates and empty for fully transparent layers.
+// spans holds one [first, last] run of non-transparent pixels per row, as a
+// region; it is only kept when it skips much more than the bounding box.
+struct LayerContent {
+    QRect bounds;
+    QRegion spans;
+};
+
+// Widget-model layer tree with parent links. A layer's own visibility is its
+// PSD flag unless the app overrides it; it is effectively visible when it
+// and every ancestor are.
+struct VisibilityNode {
+    int id = 0;
+    int parent = -1;           // node index, -1 at top level
+    std::vector<int> children;
+    bool documentVisible = true;
+    qint8 ownOverride = -1;    // -1 none, else the overriding visibility
+    bool effective = true;
+};
+
+struct VisibilityTree {
+    std::vector<VisibilityNode> nodes;  // pre-order
+    QHash<int, int> nodeById;
+};
+
+struct LayerVisibility {
+    int id;
+    bool visible;
+};
+
+// Uniform grid over the leaf layers' rects for hit-testing and region
+// queries. It holds every leaf; visibility is read from the visibility tree
+// at query time, so toggles need no rebuild.
+struct LayerGridEntry {
+    int id;
+    int node;  // visibility tree node index
+    QRect rect;
+    const QPsdAbstractLayerItem* item;
+};
+
+// 1-bit coverage of a leaf layer, derived once from its masked image: a bit
+// is set where the pixel is not fully transparent. Rows are padded to whole
+// words. Layers without alpha cover their whole rect (solid).
+struct CoverageMask {
+    QRect rect;  // canvas coordinates
+    bool solid = false;
+    int wordsPerRow = 0;
+    std::vector<quint64> bits;
+
+    bool covers(const QPoint& point) const {
+        if (!rect.contains(point)) return false;
+        if (solid) return true;
+        const int x = point.x() - rect.x();
+        const quint64 word = bits[size_t(point.y() - rect.y()) * wordsPerRow + x / 64];
+        return (word >> (x % 64)) & 1;
+    }
+};
+
+struct LayerGrid {
+    int cellSize = 0;
+    int columns = 0;
+    int rows = 0;
+    std::vector<LayerGridEntry> entries;  // topmost first
+    std::vector<std::vector<int>> cells;  // entry indices, ascending
+};
+
+// Finished full frames (RGBA8888) by render state: the visibility overrides
+// plus the text of edited static layers. Dynamic layers' text is kept per
+// layer instead, so a frame whose clock moved on is patched, not re-rendered.
+// Least recently used frames are dropped once the byte budget is exceeded.
+struct CompositeCacheEntry {
+    quint64 key;
+    std::set<int> hiddenIds;
+    std::set<int> shownIds;
+    quint64 textState;                 // static layers only
+    QHash<int, quint64> dynamicTexts;  // layer id -> text hash
+    QImage frame;
+};
+
+struct CompositeCache {
+    qsizetype budget = 64 * 1024 * 1024;
+    qsizetype bytes = 0;
+    std::list<CompositeCacheEntry> entries;  // most recently used first
+    QHash<quint64, std::list<CompositeCacheEntry>::iterator> byKey;
+};
+
+// Static/dynamic split of the scene (see setDynamicLayers()). Leaves are in
+// paint order; only the band [bandStart, bandEnd] is repainted per frame,
+// over a cached plane of the leaves below it, with the leaves above it
+// drawn from a second cached plane.
+struct SceneLeaf {
+    quint32 id;
+    bool dynamic;   // marked dynamic, or inside a dynamic folder
+    bool clipped;   // clipped onto the leaf below
+    bool plain;     // Normal blend, no effects, under plain folders only
+    quint32 group;  // outermost folder composited as a unit, 0 if none
+};
+
+struct SceneLayering {
+    bool valid = false;
+    std::vector<SceneLeaf> leaves;
+    std::set<int> dynamicIds;  // marked ids plus all their descendants
+    int bandStart = -1;        // -1: no dynamic leaves, render normally
+    int bandEnd = -1;
+    bool planesValid = false;
+    quint64 planesKey = 0;     // static visibility and text the planes show
+    QImage below;
+    QImage above;              // null when nothing sits above the band
+};
+
+// Structure to hold PSD data including models and scene
+struct PsdData {
+    std::unique_ptr<QPsdGuiLayerTreeItemModel> guiModel;
+    std::unique_ptr<QPsdExporterTreeItemModel> exporterModel;
+    std::unique_ptr<QPsdWidgetTreeItemModel> widgetModel;
+    std::unique_ptr<QPsdScene> scene;
+    int width = 0;
+    int height = 0;
+    QByteArray layerTable;  // binary layer list, see buildLayerTable()
+    QHash<int, QPersistentModelIndex> exporterIndexById;  // built on first lookup
+    QHash<int, QPersistentModelIndex> widgetIndexById;    // built on first lookup
+    // Visibility overrides of the last renderScene(), reused by partial renders.
+    // Kept equal to the layers whose effective visibility differs from their
+    // PSD flag while the visibility tree changes.
+    std::set<int> sceneHiddenIds;
+    std::set<int> sceneShownIds;
+    VisibilityTree visibility;  // built on first use
+    LayerGrid layerGrid;        // built on first query
+    // Text state for cache keys: XOR of a hash per edited layer (id + text)
+    quint64 textState = 0;
+    QHash<int, quint64> textHashes;
+    CompositeCache compositeCache;
+    std::set<int> dynamicLayerIds;
+    SceneLayering layering;
+    // Exporter folder id -> union of its visible descendants, filled in one
+    // bottom-up pass by ensureSubtreeBounds(). Exporter-model visibility is
+    // fixed after load, so the cache lives as long as the document.
+    QHash<int, QRect> subtreeBounds;
+    bool subtreeBoundsValid = false;
+    // Occlusion analysis: whether a layer's pixels are fully opaque, and the
+    // opaque region each exporter folder paints (canvas coordinates)
+    QHash<const QPsdAbstractLayerItem*, bool> opaqueLayers;
+    QHash<int, QRegion> folderOpaqueRegions;
+    QHash<const QPsdAbstractLayerItem*, LayerContent> layerContents;
+    QHash<const QPsdAbstractLayerItem*, CoverageMask> coverageMasks;
+    // Change tracking for incremental JSON export: every mutation of exported
+    // state bumps version and stamps the touched layer with it.
+    quint32 version = 0;
+    QHash<int, quint32> layerVersions;
+    PsdStats stats;
+};
+
+// Load the widget model, scene and exporter model from a PSD file.
+// Returns nullptr with error set on failure. Requires a QApplication.
+PsdData* loadPsdFile(const QString& path, std::string& error);
+
+// The same load one stage at a time, so a caller can report progress and
+// abandon it between stages (dropping a PsdLoad discards the partial data).
+enum LoadStage {
+    LoadWidgetModel, LoadScene, LoadExporterModel, LoadDone
+};
+
+struct PsdLoad {
+    QString path;
+    std::unique_ptr<PsdData> data;
+    LoadStage stage = LoadWidgetModel;
+    int layerCount = 0;  // known once the widget model is loaded
+};
+
+// Run the next stage. Returns false with error set on failure, after which
+// the load cannot continue.
+bool loadPsdStage(PsdLoad& load, std::string& error);
+// Stage name for progress reports: "widgetModel", "scene", "exporterModel", "done"
+std::string loadStageToString(LoadStage stage);
+
+int blendModeOrdinal(QPsdBlend::Mode mode);
+std::string blendModeToString(QPsdBlend::Mode mode);
+std::string itemTypeToString(QPsdAbstractLayerItem::Type type);
+
+QModelIndex findExporterIndex(PsdData* psdData, int layerId);
+QModelIndex findWidgetIndex(PsdData* psdData, int layerId);
+void markLayerChanged(PsdData* psdData, int layerId);
+
+// ========== Visibility tree ==========
+
+// Build the visibility tree if needed, seeding sceneHiddenIds/sceneShownIds
+// from it.
+void ensureVisibilityTree(PsdData* psdData);
+// Override a layer's own visibility (state 0/1) or drop the override (-1).
+// Effective visibility is updated for the affected subtree only, along with
+// sceneHiddenIds/sceneShownIds; layers whose effective visibility flipped
+// are appended to changed. Unknown ids are ignored.
+void setOwnVisibility(PsdData* psdData, int layerId, int state,
+                      std::vector<LayerVisibility>* changed = nullptr);
+// Drop every own-visibility override
+void clearOwnVisibility(PsdData* psdData, std::vector<LayerVisibility>* changed = nullptr);
+// Replace all own-visibility overrides from one byte per layer ordinal (the
+// layer's visibility tree node index): 0 none, 1 hidden, 2 shown. Only
+// layers whose byte differs from their current override are touched.
+// Returns false with error set if states does not cover the tree.
+bool setOwnVisibilityStates(PsdData* psdData, const quint8* states, qsizetype count,
+                            std::vector<LayerVisibility>* changed, std::string& error);
+
+// ========== Hit testing ==========
+
+// Coverage bitmap of a leaf layer (computed on first use, then cached)
+const CoverageMask& coverageMask(PsdData* psdData, const QPsdAbstractLayerItem* item);
+// Visible leaf layers whose rect contains the point (canvas coordinates),
+// topmost first, at most limit of them (0: all). With alpha, layers whose
+// masked pixel there is fully transparent are skipped.
+std::vector<int> hitTestLayers(PsdData* psdData, const QPoint& point, bool alpha, size_t limit = 0);
+// Topmost visible layer with a non-transparent pixel at the point, or -1
+int topmostCoveredLayer(PsdData* psdData, const QPoint& point);
+// Visible leaf layers whose rect intersects the given one, topmost first
+std::vector<int> queryLayerRegion(PsdData* psdData, const QRect& rect);
+
+// ========== Text updates ==========
+
+// Replace the text of a text layer in the widget model (what the scene
+// renders), keeping the style of its first run. Returns false with error
+// set if the layer is missing, not a text layer or has no runs.
+bool setTextLayerText(PsdData* psdData, int layerId, const QString& text, std::string& error);
+// Canvas area to repaint after a text layer's content changed: the full
+// width of its rows (new text may be wider), or the whole canvas when the
+// layer has effects.
+QRect textDirtyRect(PsdData* psdData, int layerId);
+
+// ========== Compositing ==========
+
+void ensureSubtreeBounds(PsdData* psdData);
+// Cached bounds of the visible children of a folder (after ensureSubtreeBounds)
+QRect subtreeBounds(const PsdData* psdData, const QModelIndex& folder);
+// Trimmed content of a leaf layer (computed on first use, then cached)
+const LayerContent& layerContent(PsdData* psdData, const QPsdAbstractLayerItem* item);
+// The layer image with transparency and layer masks applied. A non-empty
+// area (layer coordinates) restricts the work and the result to that part.
+QImage applyMasks(const QPsdAbstractLayerItem* item, const QRect& area = QRect());
+// Layers entirely inside coveredAbove (canvas coordinates, painted opaque by
+// layers above) are skipped, partially covered ones are clipped.
+void compositeChildren(PsdData* psdData,
+                       const QModelIndex& parent, QPainter& painter,
+                       const QPoint& origin, bool passThrough,
+                       const QRegion& coveredAbove = QRegion());
+
+// Composite the visible children of a folder; bounds receives the canvas
+// rect. Returns a null image if the folder has no visible content.
+QImage compositeFolder(PsdData* psdData, const QModelIndex& index, QRect& bounds);
+
+// Render the scene with the original visibility plus the given overrides,
+// as ARGB32_Premultiplied at document size, or only the given area of it.
+QImage renderScene(PsdData* psdData, const std::set<int>& hiddenIds, const std::set<int>& shownIds,
+                   const QRect& area = QRect());
+
+// Layers (or folders) the app changes at runtime. While any are set,
+// renderScene() keeps the rest of the document in cached planes and only
+// repaints the dynamic band. An empty set turns the split off.
+void setDynamicLayers(PsdData* psdData, const std::set<int>& layerIds);
+
+// ========== Composite cache ==========
+
+// Full frame for the given overrides as RGBA8888, served from the composite
+// cache when the same visibility and static text state was rendered before;
+// dynamic text layers that changed since are repainted into the cached frame.
+QImage compositeFrame(PsdData* psdData, const std::set<int>& hiddenIds, const std::set<int>& shownIds);
+// Render a state into the cache ahead of time (no-op if already cached),
+// leaving the overrides later partial renders start from and the static
+// planes of setDynamicLayers() unchanged.
+void prerenderFrame(PsdData* psdData, const std::set<int>& hiddenIds, const std::set<int>& shownIds);
+// Byte budget of the cache; 0 disables it. Shrinking evicts immediately.
+void setCompositeCacheBudget(PsdData* psdData, qsizetype bytes);
+// Drop all cached frames (e.g. after fonts change)
+void clearCompositeCache(PsdData* psdData);
+// prerenderFrame() for the current own-visibility overrides plus the given
+// ones, which are not kept
+void prerenderVisibility(PsdData* psdData, const std::vector<LayerVisibility>& overrides);
+
+// ========== State deltas ==========
+
+// Apply a binary state delta (see psdrun_core.cpp for the layout) on top of
+// the current own-visibility overrides and text. All records are validated
+// before anything changes, so the delta applies completely or not at all.
+// dirty receives the canvas area that needs re-rendering (empty if nothing
+// changed), visibilityChanged the layers whose effective visibility flipped.
+bool applyStateDelta(PsdData* psdData, const char* data, qsizetype size, QRect& dirty,
+                     std::vector<LayerVisibility>& visibilityChanged, std::string& error);
+
+// ========== Layer table ==========
+
+void buildLayerTable(PsdData* psdData);
+
+// ========== Layer JSON export ==========
+
+// Minimal streaming JSON writer that appends straight into a byte buffer,
+// so large trees are serialized in one pass without a QJsonDocument.
+class JsonWriter {
+public:
+    explicit JsonWriter(QByteArray& out) : m_out(out) {}
+
+    void beginObject() { separate(); m_out.append('{'); m_first.push_back(true); }
+    void endObject() { m_first.pop_back(); m_out.append('}'); }
+    void beginArray() { separate(); m_out.append('['); m_first.push_back(true); }
+    void endArray() { m_first.pop_back(); m_out.append(']'); }
+
+    void key(const char* name) {
+        separate();
+        m_out.append('"').append(name).append("\":");
+        m_afterKey = true;
+    }
+
+    void value(const QString& str) { separate(); writeString(str); }
+    void value(const char* str) { separate(); m_out.append('"').append(str).append('"'); }
+    void value(bool b) { separate(); m_out.append(b ? "true" : "false"); }
+    void value(int i) { separate(); m_out.append(QByteArray::number(i)); }
+    void value(double d);
+
+    template <typename T>
+    void field(const char* name, const T& v) { key(name); value(v); }
+
+private:
+    void separate() {
+        if (m_afterKey) {
+            m_afterKey = false;
+            return;
+        }
+        if (m_first.empty()) return;
+        if (m_first.back())
+            m_first.back() = false;
+        else
+            m_out.append(',');
+    }
+
+    void writeString(const QString& str);
+
+    QByteArray& m_out;
+    std::vector<bool> m_first;
+    bool m_afterKey = false;
+};
+
+// Field groups for exportLayerJson; layerId, name and type are always written
+enum LayerJsonField {
+    JsonRect = 0x01,
+    JsonOpacity = 0x02,     // opacity, fillOpacity
+    JsonVisible = 0x04,
+    JsonText = 0x08,        // runs
+    JsonShape = 0x10,       // brushColor, pathType, cornerRadius
+    JsonFolder = 0x20,      // childCount, isOpened
+    JsonImage = 0x40,       // linkedFile
+    JsonHint = 0x80,        // hintType, hintVisible, hintProperties
+    JsonAllFields = 0xff,   // every group above, the export default
+    JsonVersion = 0x100     // opt-in: version (last change, 0 = unchanged since load)
+};
+
+void writeLayerJson(JsonWriter& writer, const PsdData* psdData,
+                    const QModelIndex& index, int depth, int maxDepth, int fields);
+
+// Serialize the layer tree into out. rootLayerId < 0 exports the whole
+// document; maxDepth < 0 means unlimited (0 writes only the roots).
+bool writeDocumentJson(PsdData* psdData, QByteArray& out, int rootLayerId, int maxDepth, int fields);
+
+// ========== Export hints ==========
+
+// Non-default hints in the qtpsdparser.hint JSON format
+QByteArray hintsToJson(PsdData* psdData);
+// Restore hints written by hintsToJson(); returns the number of layers
+// restored, or -1 if the JSON is invalid.
+int hintsFromJson(PsdData* psdData, const QByteArray& json);
+
+#endif // PSDRUN_CORE_H
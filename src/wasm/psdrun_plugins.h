@@ -0,0 +1,22 @@
+// Copyright (C) 2026 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+//
+// Compiled-in static plugin registry. The table is generated by CMake from
+// the PSDRUN_*_PLUGINS lists (see psdrun_plugins.cpp.in) and is empty in
+// builds that load plugins dynamically.
+
+#ifndef PSDRUN_PLUGINS_H
+#define PSDRUN_PLUGINS_H
+
+#include <QtCore/QtPlugin>
+
+struct PsdRunStaticPlugin {
+    const char* category;   // AdditionalLayerInformation, Descriptor, EffectsLayer
+    const char* name;       // e.g. "Lfx2", "TySh"
+    const QStaticPlugin (*plugin)();  // as declared by Q_IMPORT_PLUGIN
+};
+
+// Terminated by an entry with a null name
+extern const PsdRunStaticPlugin psdRunStaticPlugins[];
+
+#endif // PSDRUN_PLUGINS_H
@@ -5,106 +5,49 @@
 // Based on psd-compare's psddiff_qt.cpp + mcp-psd2x layer image/hints functions.
 
 #include <emscripten/bind.h>
+#include <emscripten/emscripten.h>
+#include <emscripten/heap.h>
 #include <emscripten/val.h>
-#include <vector>
+#include <malloc.h>
 #include <set>
+#include <utility>
 
-#include <QtCore/QBuffer>
 #include <QtCore/QFile>
 #include <QtCore/QDir>
 #include <QtCore/QJsonArray>
-#include <QtCore/QJsonDocument>
 #include <QtCore/QJsonObject>
 #include <QtWidgets/QApplication>
-#include <QtPlugin>
 #include <QtGui/QImage>
-#include <QtGui/QPainter>
 #include <QtGui/QFontDatabase>
 
-#include <QtPsdCore/QPsdParser>
-#include <QtPsdCore/QPsdLayerRecord>
-#include <QtPsdCore/qpsdblend.h>
-#include <QtPsdCore/QPsdSectionDividerSetting>
-
 #include <QtPsdGui/QPsdAbstractLayerItem>
-#include <QtPsdGui/QPsdFolderLayerItem>
 #include <QtPsdGui/QPsdTextLayerItem>
-#include <QtPsdGui/QPsdShapeLayerItem>
-#include <QtPsdGui/QPsdImageLayerItem>
-#include <QtPsdGui/QPsdGuiLayerTreeItemModel>
-#include <QtPsdGui/qpsdguiglobal.h>
-
-#include <QtPsdWidget/QPsdWidgetTreeItemModel>
-#include <QtPsdWidget/QPsdScene>
-
-#include <QtPsdExporter/QPsdExporterTreeItemModel>
-
-// Import static plugins for WASM
-// Additional Layer Information plugins
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationAnnoPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationBlncPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationBritPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationBrstPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationClrlPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationCurvPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationDataPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationExpaPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationFeidPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationFMskPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationGrdmPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationHue2Plugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationLclrPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationLevlPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationLfx2Plugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationLMskPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationLnk_Plugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationLr16Plugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationLrFXPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationLsctPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationLsdkPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationLuniPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationMixrPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationNonePlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationPattPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationPhflPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationPlLdPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationQpointFPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationSelcPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationShmdPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationSoLdPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationTyShPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationU8Plugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationU16Plugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationU32Plugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationUnknownPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationV16DescriptorPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationVmskPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationVogkPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationVscgPlugin)
-Q_IMPORT_PLUGIN(QPsdAdditionalLayerInformationVstkPlugin)
-// Descriptor plugins
-Q_IMPORT_PLUGIN(QPsdDescriptorBoolPlugin)
-Q_IMPORT_PLUGIN(QPsdDescriptorDoubPlugin)
-Q_IMPORT_PLUGIN(QPsdDescriptorEnumPlugin)
-Q_IMPORT_PLUGIN(QPsdDescriptorLongPlugin)
-Q_IMPORT_PLUGIN(QPsdDescriptorObArPlugin)
-Q_IMPORT_PLUGIN(QPsdDescriptorObjPlugin)
-Q_IMPORT_PLUGIN(QPsdDescriptorObjcPlugin)
-Q_IMPORT_PLUGIN(QPsdDescriptorPthPlugin)
-Q_IMPORT_PLUGIN(QPsdDescriptorTdtaPlugin)
-Q_IMPORT_PLUGIN(QPsdDescriptorTextPlugin)
-Q_IMPORT_PLUGIN(QPsdDescriptorUntFPlugin)
-Q_IMPORT_PLUGIN(QPsdDescriptorVlLsPlugin)
-// Effects layer plugins
-Q_IMPORT_PLUGIN(QPsdEffectsLayerBevlPlugin)
-Q_IMPORT_PLUGIN(QPsdEffectsLayerCmnSPlugin)
-Q_IMPORT_PLUGIN(QPsdEffectsLayerIglwPlugin)
-Q_IMPORT_PLUGIN(QPsdEffectsLayerOglwPlugin)
-Q_IMPORT_PLUGIN(QPsdEffectsLayerShadowPlugin)
-Q_IMPORT_PLUGIN(QPsdEffectsLayerSofiPlugin)
+
+// Document loading, compositing and JSON export shared with the native bench
+#include "psdrun_core.h"
+// Static plugins are imported by the generated psdrun_plugins.cpp
+#include "psdrun_plugins.h"
 
 using namespace emscripten;
 
+// ========== Startup / phase timing ==========
+
+val getTimings() {
+    val result = val::array();
+    for (const auto& timing : phaseTimings()) {
+        val entry = val::object();
+        entry.set("name", timing.name);
+        entry.set("start", timing.start);
+        entry.set("duration", timing.duration);
+        result.call<void>("push", entry);
+    }
+    return result;
+}
+
+void clearTimings() {
+    phaseTimings().clear();
+}
+
 // Global Qt application instance
 static int s_argc = 1;
 static char* s_argv[] = { (char*)"psdrun_qt", nullptr };
@@ -115,6 +58,7 @@ static QByteArray s_dataBuffer;
 
 void ensureQtApp() {
     if (!s_app) {
+        PhaseTimer timer("qtInit");
         s_app = new QApplication(s_argc, s_argv);
         QDir().mkpath("/tmp");
     }
@@ -129,6 +73,8 @@ val getBufferView() {
                reinterpret_cast<unsigned char*>(s_dataBuffer.data())));
 }
 
+static PsdData* s_parsers[16] = {nullptr};
+
 // Font buffer for receiving font data from JavaScript
 static QByteArray s_fontBuffer;
 static std::vector<std::string> s_registeredFontFamilies;
@@ -151,7 +97,11 @@ val registerFont(int dataSize, const std::string& filename) {
         return result;
     }
 
-    QByteArray fontData(s_fontBuffer.constData(), dataSize);
+    // Hand the buffer over instead of copying it; the font database keeps
+    // its own reference, so nothing transient stays allocated afterwards.
+    s_fontBuffer.truncate(dataSize);
+    QByteArray fontData = std::exchange(s_fontBuffer, QByteArray());
+    PhaseTimer timer("fontRegister");
     int fontId = QFontDatabase::addApplicationFontFromData(fontData);
 
     if (fontId < 0) {
@@ -172,6 +122,11 @@ val registerFont(int dataSize, const std::string& filename) {
         familiesArray.call<void>("push", familyStr);
     }
 
+    // Frames rendered with the previous fonts are stale
+    for (PsdData* psdData : s_parsers) {
+        if (psdData) clearCompositeCache(psdData);
+    }
+
     result.set("fontId", fontId);
     result.set("families", familiesArray);
     return result;
@@ -185,63 +140,6 @@ val getRegisteredFonts() {
     return result;
 }
 
-std::string blendModeToString(QPsdBlend::Mode mode) {
-    switch (mode) {
-        case QPsdBlend::PassThrough: return "passThrough";
-        case QPsdBlend::Normal: return "normal";
-        case QPsdBlend::Dissolve: return "dissolve";
-        case QPsdBlend::Darken: return "darken";
-        case QPsdBlend::Multiply: return "multiply";
-        case QPsdBlend::ColorBurn: return "colorBurn";
-        case QPsdBlend::LinearBurn: return "linearBurn";
-        case QPsdBlend::DarkerColor: return "darkerColor";
-        case QPsdBlend::Lighten: return "lighten";
-        case QPsdBlend::Screen: return "screen";
-        case QPsdBlend::ColorDodge: return "colorDodge";
-        case QPsdBlend::LinearDodge: return "linearDodge";
-        case QPsdBlend::LighterColor: return "lighterColor";
-        case QPsdBlend::Overlay: return "overlay";
-        case QPsdBlend::SoftLight: return "softLight";
-        case QPsdBlend::HardLight: return "hardLight";
-        case QPsdBlend::VividLight: return "vividLight";
-        case QPsdBlend::LinearLight: return "linearLight";
-        case QPsdBlend::PinLight: return "pinLight";
-        case QPsdBlend::HardMix: return "hardMix";
-        case QPsdBlend::Difference: return "difference";
-        case QPsdBlend::Exclusion: return "exclusion";
-        case QPsdBlend::Subtract: return "subtract";
-        case QPsdBlend::Divide: return "divide";
-        case QPsdBlend::Hue: return "hue";
-        case QPsdBlend::Saturation: return "saturation";
-        case QPsdBlend::Color: return "color";
-        case QPsdBlend::Luminosity: return "luminosity";
-        default: return "normal";
-    }
-}
-
-std::string itemTypeToString(QPsdAbstractLayerItem::Type type) {
-    switch (type) {
-        case QPsdAbstractLayerItem::Text: return "text";
-        case QPsdAbstractLayerItem::Shape: return "shape";
-        case QPsdAbstractLayerItem::Image: return "image";
-        case QPsdAbstractLayerItem::Folder: return "folder";
-        default: return "unknown";
-    }
-}
-
-// Structure to hold PSD data including models and scene
-struct PsdData {
-    QString tempPath;
-    std::unique_ptr<QPsdGuiLayerTreeItemModel> guiModel;
-    std::unique_ptr<QPsdExporterTreeItemModel> exporterModel;
-    std::unique_ptr<QPsdWidgetTreeItemModel> widgetModel;
-    std::unique_ptr<QPsdScene> scene;
-    int width = 0;
-    int height = 0;
-};
-
-static PsdData* s_parsers[16] = {nullptr};
-
 static int findFreeHandle() {
     for (int i = 1; i < 16; i++) {
         if (s_parsers[i] == nullptr) return i;
@@ -249,192 +147,123 @@ static int findFreeHandle() {
     return -1;
 }
 
-// ========== Layer image compositing helpers (ported from mcp-psd2x) ==========
-
-// Recursively compute bounding box of all visible children under parent
-static QRect computeBoundingRect(const QPsdExporterTreeItemModel* model, const QModelIndex& parent) {
-    QRect bounds;
-    for (int row = 0; row < model->rowCount(parent); ++row) {
-        auto index = model->index(row, 0, parent);
-        const auto* item = model->layerItem(index);
-        if (!item || !item->isVisible()) continue;
-        if (item->type() == QPsdAbstractLayerItem::Folder) {
-            bounds = bounds.united(computeBoundingRect(model, index));
-        } else {
-            bounds = bounds.united(item->rect());
-        }
-    }
-    return bounds;
-}
-
-// Apply transparency mask and raster layer mask to a layer's image
-static QImage applyMasks(const QPsdAbstractLayerItem* item) {
-    QImage image = item->image();
-    if (image.isNull()) return image;
-
-    // Apply transparency mask for layers without built-in alpha
-    const QImage transMask = item->transparencyMask();
-    if (!transMask.isNull() && !image.hasAlphaChannel()) {
-        image = image.convertToFormat(QImage::Format_ARGB32);
-        for (int y = 0; y < qMin(image.height(), transMask.height()); ++y) {
-            QRgb* imgLine = reinterpret_cast<QRgb*>(image.scanLine(y));
-            const uchar* maskLine = transMask.constScanLine(y);
-            for (int x = 0; x < qMin(image.width(), transMask.width()); ++x) {
-                imgLine[x] = qRgba(qRed(imgLine[x]), qGreen(imgLine[x]),
-                                   qBlue(imgLine[x]), maskLine[x]);
-            }
-        }
-    }
-
-    // Apply raster layer mask if present
-    const QImage layerMask = item->layerMask();
-    if (!layerMask.isNull()) {
-        const QRect maskRect = item->layerMaskRect();
-        const QRect layerRect = item->rect();
-        const int defaultColor = item->layerMaskDefaultColor();
-
-        image = image.convertToFormat(QImage::Format_ARGB32);
-        for (int y = 0; y < image.height(); ++y) {
-            QRgb* scanLine = reinterpret_cast<QRgb*>(image.scanLine(y));
-            for (int x = 0; x < image.width(); ++x) {
-                const int maskX = (layerRect.x() + x) - maskRect.x();
-                const int maskY = (layerRect.y() + y) - maskRect.y();
-                int maskValue = defaultColor;
-                if (maskX >= 0 && maskX < layerMask.width() &&
-                    maskY >= 0 && maskY < layerMask.height()) {
-                    maskValue = qGray(layerMask.pixel(maskX, maskY));
-                }
-                const int alpha = qAlpha(scanLine[x]);
-                const int newAlpha = (alpha * maskValue) / 255;
-                scanLine[x] = qRgba(qRed(scanLine[x]), qGreen(scanLine[x]),
-                                    qBlue(scanLine[x]), newAlpha);
-            }
-        }
-    }
-
-    return image;
-}
-
-// Recursively composite visible children onto the given painter
-static void compositeChildren(const QPsdExporterTreeItemModel* model,
-                              const QModelIndex& parent, QPainter& painter,
-                              const QPoint& origin, bool passThrough) {
-    const int count = model->rowCount(parent);
-    // Bottom-to-top (last row = bottommost layer in PSD model)
-    for (int row = count - 1; row >= 0; --row) {
-        auto index = model->index(row, 0, parent);
-        const auto* item = model->layerItem(index);
-        if (!item || !item->isVisible()) continue;
-
-        if (item->type() == QPsdAbstractLayerItem::Folder) {
-            const auto folderBlend = item->record().blendMode();
-            const bool folderPassThrough = (folderBlend == QPsdBlend::PassThrough);
-
-            if (folderPassThrough) {
-                compositeChildren(model, index, painter, origin, true);
-            } else {
-                const QRect childBounds = computeBoundingRect(model, index);
-                if (childBounds.isEmpty()) continue;
-
-                QImage groupCanvas(childBounds.size(), QImage::Format_ARGB32);
-                groupCanvas.fill(Qt::transparent);
+// ========== Main API functions ==========
 
-                QPainter groupPainter(&groupCanvas);
-                compositeChildren(model, index, groupPainter, childBounds.topLeft(), false);
-                groupPainter.end();
+// Staged parses in progress (see beginParse()), by parse id
+struct PendingParse {
+    PsdLoad load;
+    qint64 bytes = 0;
+    double elapsedMs = 0;  // time spent in stages, without the gaps between
+};
+static std::unique_ptr<PendingParse> s_pendingParses[16];
 
-                painter.save();
-                painter.setCompositionMode(QtPsdGui::compositionMode(folderBlend));
-                painter.setOpacity(painter.opacity() * item->opacity() * item->fillOpacity());
-                painter.drawImage(childBounds.topLeft() - origin, groupCanvas);
-                painter.restore();
-            }
-        } else {
-            QImage layerImage = applyMasks(item);
-            if (layerImage.isNull()) continue;
-
-            painter.save();
-            painter.setCompositionMode(
-                QtPsdGui::compositionMode(item->record().blendMode()));
-            painter.setOpacity(painter.opacity() * item->opacity() * item->fillOpacity());
-            painter.drawImage(item->rect().topLeft() - origin, layerImage);
-            painter.restore();
-        }
-    }
+static void endLoad(int parseId) {
+    // Once the models have read it (or given up), the MEMFS copy is not needed
+    QFile::remove(s_pendingParses[parseId]->load.path);
+    s_pendingParses[parseId].reset();
 }
 
-// ========== Main API functions ==========
-
-// Parse PSD and return parser handle with extended layer info
-val parsePsd(int dataSize) {
+// Write the PSD in s_dataBuffer to a temp file and start a staged load.
+// Returns its parse id, or -1 with error set.
+static int beginLoad(int dataSize, std::string& error) {
     ensureQtApp();
-    val result = val::object();
+    const double loadStart = nowMs();
 
     if (dataSize <= 0 || dataSize > s_dataBuffer.size()) {
-        result.set("error", "Invalid data size");
-        return result;
+        error = "Invalid data size";
+        return -1;
+    }
+    int parseId = -1;
+    for (int i = 1; i < 16 && parseId < 0; i++) {
+        if (!s_pendingParses[i]) parseId = i;
+    }
+    if (parseId < 0) {
+        error = "Too many parses in progress";
+        return -1;
     }
-
-    PsdData* psdData = new PsdData();
 
     // Save to temp file
     static int tempFileCounter = 0;
-    psdData->tempPath = QString("/tmp/psd_%1.psd").arg(tempFileCounter++);
-    QFile tempFile(psdData->tempPath);
+    const QString tempPath = QString("/tmp/psd_%1.psd").arg(tempFileCounter++);
+    QFile tempFile(tempPath);
     if (!tempFile.open(QIODevice::WriteOnly)) {
-        delete psdData;
-        result.set("error", "Cannot create temp file");
-        return result;
+        error = "Cannot create temp file";
+        return -1;
+    }
+    {
+        PhaseTimer timer("parse.writeTemp");
+        tempFile.write(s_dataBuffer.constData(), dataSize);
+        tempFile.close();
     }
-    tempFile.write(s_dataBuffer.constData(), dataSize);
-    tempFile.close();
 
-    // Load using QPsdWidgetTreeItemModel (for scene rendering)
-    psdData->widgetModel = std::make_unique<QPsdWidgetTreeItemModel>();
-    psdData->widgetModel->load(psdData->tempPath);
+    // The temp file now holds the document; drop the transfer buffer before
+    // the models decode it so peak usage is not file size x 3.
+    s_dataBuffer = QByteArray();
 
-    if (!psdData->widgetModel->errorMessage().isEmpty()) {
-        QString error = psdData->widgetModel->errorMessage();
-        delete psdData;
-        result.set("error", std::string("Failed to load PSD: ") + error.toStdString());
-        return result;
-    }
+    auto pending = std::make_unique<PendingParse>();
+    pending->load.path = tempPath;
+    pending->bytes = dataSize;
+    pending->elapsedMs = nowMs() - loadStart;
+    s_pendingParses[parseId] = std::move(pending);
+    return parseId;
+}
 
-    QSize size = psdData->widgetModel->size();
-    psdData->width = size.width();
-    psdData->height = size.height();
+// Run the next stage of a load; a failed load is ended
+static bool runLoadStage(int parseId, std::string& error) {
+    PendingParse& pending = *s_pendingParses[parseId];
+    const double stageStart = nowMs();
+    const bool ok = loadPsdStage(pending.load, error);
+    pending.elapsedMs += nowMs() - stageStart;
+    if (!ok) endLoad(parseId);
+    return ok;
+}
 
-    if (psdData->width == 0 || psdData->height == 0) {
-        delete psdData;
-        result.set("error", "Invalid dimensions");
-        return result;
+// Register a finished load's document under a parser handle. Returns the
+// handle, or -1 with error set; the load is ended either way.
+static int finishLoad(int parseId, std::string& error) {
+    PendingParse& pending = *s_pendingParses[parseId];
+    int handle = findFreeHandle();
+    if (handle < 0) {
+        endLoad(parseId);
+        error = "Too many parsers allocated";
+        return -1;
     }
+    PsdData* psdData = pending.load.data.release();
+    s_parsers[handle] = psdData;
 
-    // Create scene for Qt rendering
-    psdData->scene = std::make_unique<QPsdScene>();
-    psdData->scene->setModel(psdData->widgetModel.get());
+    if (g_statsEnabled) {
+        CallStats& call = psdData->stats.calls[StatParse];
+        call.count = 1;
+        call.totalMs = call.maxMs = pending.elapsedMs;
+    }
+    endLoad(parseId);
+    return handle;
+}
 
-    // Load using QPsdExporterTreeItemModel (for hints + layer details)
-    psdData->guiModel = std::make_unique<QPsdGuiLayerTreeItemModel>();
-    psdData->exporterModel = std::make_unique<QPsdExporterTreeItemModel>();
-    psdData->exporterModel->setSourceModel(psdData->guiModel.get());
-    psdData->exporterModel->load(psdData->tempPath);
+// Load the PSD in s_dataBuffer into a new PsdData and register a handle.
+// Returns the handle, or -1 with error set.
+static int loadPsd(int dataSize, std::string& error) {
+    PhaseTimer parseTimer("parse");
 
-    if (!psdData->exporterModel->errorMessage().isEmpty()) {
-        QString error = psdData->exporterModel->errorMessage();
-        delete psdData;
-        result.set("error", std::string("Failed to load exporter model: ") + error.toStdString());
-        return result;
+    const int parseId = beginLoad(dataSize, error);
+    if (parseId < 0) return -1;
+    while (s_pendingParses[parseId]->load.stage != LoadDone) {
+        if (!runLoadStage(parseId, error)) return -1;
     }
+    return finishLoad(parseId, error);
+}
 
-    // Store in handle array
-    int handle = findFreeHandle();
+// Parse PSD and return parser handle with extended layer info
+val parsePsd(int dataSize) {
+    val result = val::object();
+
+    std::string error;
+    int handle = loadPsd(dataSize, error);
     if (handle < 0) {
-        delete psdData;
-        result.set("error", "Too many parsers allocated");
+        result.set("error", error);
         return result;
     }
-    s_parsers[handle] = psdData;
+    PsdData* psdData = s_parsers[handle];
 
     result.set("handle", handle);
     result.set("width", psdData->width);
@@ -503,7 +332,144 @@ val parsePsd(int dataSize) {
     return result;
 }
 
-// Render composite using QPsdScene
+// Parse PSD without building per-layer JS objects; the layer list is
+// fetched in one piece with getLayerTable().
+val parsePsdCompact(int dataSize) {
+    val result = val::object();
+
+    std::string error;
+    int handle = loadPsd(dataSize, error);
+    if (handle < 0) {
+        result.set("error", error);
+        return result;
+    }
+    PsdData* psdData = s_parsers[handle];
+    buildLayerTable(psdData);
+
+    result.set("handle", handle);
+    result.set("width", psdData->width);
+    result.set("height", psdData->height);
+    result.set("layerTableSize", static_cast<int>(psdData->layerTable.size()));
+    return result;
+}
+
+// Staged parse: beginParse() takes the PSD in s_dataBuffer, each
+// continueParse() runs one stage and returns in between, so the caller can
+// report progress, yield to the event loop and cancelParse() a document it
+// no longer wants. Progress is stage/stages plus the name of the stage the
+// next call runs, with the document's bytes and, after the first stage, its
+// layer count. The last stage returns what
+// parsePsdCompact() does.
+val beginParse(int dataSize) {
+    val result = val::object();
+    std::string error;
+    const int parseId = beginLoad(dataSize, error);
+    if (parseId < 0) {
+        result.set("error", error);
+        return result;
+    }
+    result.set("parseId", parseId);
+    result.set("stage", 0);
+    result.set("stages", static_cast<int>(LoadDone));
+    result.set("stageName", loadStageToString(LoadWidgetModel));
+    result.set("bytes", static_cast<double>(s_pendingParses[parseId]->bytes));
+    return result;
+}
+
+val continueParse(int parseId) {
+    val result = val::object();
+    if (parseId < 1 || parseId >= 16 || !s_pendingParses[parseId]) {
+        result.set("error", std::string("Invalid parse id"));
+        return result;
+    }
+
+    try {
+        std::string error;
+        if (!runLoadStage(parseId, error)) {
+            result.set("error", error);
+            return result;
+        }
+        const PendingParse& pending = *s_pendingParses[parseId];
+        result.set("stage", static_cast<int>(pending.load.stage));
+        result.set("stages", static_cast<int>(LoadDone));
+        result.set("stageName", loadStageToString(pending.load.stage));
+        result.set("bytes", static_cast<double>(pending.bytes));
+        result.set("layers", pending.load.layerCount);
+        if (pending.load.stage != LoadDone) return result;
+
+        const int handle = finishLoad(parseId, error);
+        if (handle < 0) {
+            result.set("error", error);
+            return result;
+        }
+        PsdData* psdData = s_parsers[handle];
+        buildLayerTable(psdData);
+        result.set("handle", handle);
+        result.set("width", psdData->width);
+        result.set("height", psdData->height);
+        result.set("layerTableSize", static_cast<int>(psdData->layerTable.size()));
+        return result;
+    } catch (const std::exception& e) {
+        if (s_pendingParses[parseId]) endLoad(parseId);
+        result.set("error", std::string("Exception: ") + e.what());
+        return result;
+    } catch (...) {
+        if (s_pendingParses[parseId]) endLoad(parseId);
+        result.set("error", "Unknown exception");
+        return result;
+    }
+}
+
+// Abandon a staged parse, freeing what it decoded so far
+void cancelParse(int parseId) {
+    if (parseId >= 1 && parseId < 16 && s_pendingParses[parseId]) {
+        endLoad(parseId);
+    }
+}
+
+// View of the binary layer table in WASM memory. The view is invalidated by
+// memory growth, so callers must copy it before calling back into the module.
+val getLayerTable(double handleD) {
+    int handle = static_cast<int>(handleD);
+    if (handle < 1 || handle >= 16 || s_parsers[handle] == nullptr) {
+        return val::null();
+    }
+    PsdData* psdData = s_parsers[handle];
+    if (psdData->layerTable.isEmpty()) {
+        buildLayerTable(psdData);
+    }
+    return val(typed_memory_view(psdData->layerTable.size(),
+               reinterpret_cast<const unsigned char*>(psdData->layerTable.constData())));
+}
+
+// Copy an image into a new JS Uint8ClampedArray as RGBA8888
+static val copyImageData(const QImage& image) {
+    QImage rgbaImage = image.convertToFormat(QImage::Format_RGBA8888);
+    qsizetype byteCount = rgbaImage.sizeInBytes();
+
+    val Uint8ClampedArray = val::global("Uint8ClampedArray");
+    val data = Uint8ClampedArray.new_(static_cast<unsigned int>(byteCount));
+    val sourceView = val(typed_memory_view(byteCount, rgbaImage.constBits()));
+    data.call<void>("set", sourceView);
+    addStat(&PsdStats::bytesCopied, double(byteCount));
+    return data;
+}
+
+// [{id, visible}, ...]
+static val layerVisibilityArray(const std::vector<LayerVisibility>& layers) {
+    val array = val::array();
+    for (const LayerVisibility& layer : layers) {
+        val entry = val::object();
+        entry.set("id", layer.id);
+        entry.set("visible", layer.visible);
+        array.call<void>("push", entry);
+    }
+    return array;
+}
+
+// Render composite using QPsdScene. The ids replace all own-visibility
+// overrides (hidden: forced off, shown: forced on); folders still hide
+// their contents.
 val renderCompositeWithQt(double handleD, val hiddenLayerIdsVal, val shownLayerIdsVal) {
     val result = val::object();
     int handle = static_cast<int>(handleD);
@@ -514,6 +480,7 @@ val renderCompositeWithQt(double handleD, val hiddenLayerIdsVal, val shownLayerI
             return result;
         }
         PsdData* psdData = s_parsers[handle];
+        CallTimer callTimer(psdData->stats, StatRender);
 
         int width = psdData->width;
         int height = psdData->height;
@@ -532,49 +499,154 @@ val renderCompositeWithQt(double handleD, val hiddenLayerIdsVal, val shownLayerI
             shownIds.insert(shownLayerIdsVal[i].as<int>());
         }
 
-        // Reset visibility to original state
-        std::function<void(const QModelIndex&)> resetVisibility = [&](const QModelIndex& parent) {
-            for (int row = 0; row < psdData->widgetModel->rowCount(parent); ++row) {
-                QModelIndex index = psdData->widgetModel->index(row, 0, parent);
-                const auto* layerItem = psdData->widgetModel->layerItem(index);
-                if (layerItem) {
-                    quint32 layerId = layerItem->id();
-                    bool originalVisible = layerItem->isVisible();
-                    psdData->scene->setItemVisible(layerId, originalVisible);
-                }
-                resetVisibility(index);
-            }
-        };
-        resetVisibility(QModelIndex());
+        clearOwnVisibility(psdData);
+        for (int id : hiddenIds) setOwnVisibility(psdData, id, 0);
+        for (int id : shownIds) setOwnVisibility(psdData, id, 1);
 
-        // Apply visibility overrides
-        for (int id : hiddenIds) {
-            psdData->scene->setItemVisible(static_cast<quint32>(id), false);
-        }
-        for (int id : shownIds) {
-            psdData->scene->setItemVisible(static_cast<quint32>(id), true);
+        const QImage frame = compositeFrame(psdData, psdData->sceneHiddenIds, psdData->sceneShownIds);
+        result.set("width", width);
+        result.set("height", height);
+        result.set("data", copyImageData(frame));
+        return result;
+    } catch (const std::exception& e) {
+        result.set("error", std::string("Exception: ") + e.what());
+        return result;
+    } catch (...) {
+        result.set("error", "Unknown exception");
+        return result;
+    }
+}
+
+// Layer ids by ordinal (visibility tree order) as an Int32Array, for
+// building the state array renderCompositeWithStates() takes
+val getLayerOrdinals(double handleD) {
+    int handle = static_cast<int>(handleD);
+    if (handle < 1 || handle >= 16 || s_parsers[handle] == nullptr) {
+        return val::global("Int32Array").new_(0);
+    }
+    PsdData* psdData = s_parsers[handle];
+    ensureVisibilityTree(psdData);
+
+    std::vector<int> ids;
+    ids.reserve(psdData->visibility.nodes.size());
+    for (const VisibilityNode& node : psdData->visibility.nodes) ids.push_back(node.id);
+    val ordinals = val::global("Int32Array").new_(static_cast<unsigned int>(ids.size()));
+    ordinals.call<void>("set", val(typed_memory_view(ids.size(), ids.data())));
+    return ordinals;
+}
+
+// renderCompositeWithQt() with the overrides as one byte per layer ordinal
+// in s_dataBuffer (0 none, 1 hidden, 2 shown), read in one pass without a
+// call per id. Also returns the layers whose effective visibility flipped.
+val renderCompositeWithStates(double handleD, int stateCount) {
+    val result = val::object();
+    int handle = static_cast<int>(handleD);
+
+    if (handle < 1 || handle >= 16 || s_parsers[handle] == nullptr) {
+        result.set("error", std::string("Invalid parser handle"));
+        return result;
+    }
+    if (stateCount < 0 || stateCount > s_dataBuffer.size()) {
+        result.set("error", "Invalid state count");
+        return result;
+    }
+    PsdData* psdData = s_parsers[handle];
+    CallTimer callTimer(psdData->stats, StatRender);
+
+    try {
+        std::vector<LayerVisibility> changed;
+        std::string error;
+        if (!setOwnVisibilityStates(psdData, reinterpret_cast<const quint8*>(s_dataBuffer.constData()),
+                                    stateCount, &changed, error)) {
+            result.set("error", error);
+            return result;
         }
 
-        // Render scene
-        QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
-        image.fill(Qt::transparent);
+        const QImage frame = compositeFrame(psdData, psdData->sceneHiddenIds, psdData->sceneShownIds);
+        result.set("width", psdData->width);
+        result.set("height", psdData->height);
+        result.set("data", copyImageData(frame));
+        result.set("visibility", layerVisibilityArray(changed));
+        return result;
+    } catch (const std::exception& e) {
+        result.set("error", std::string("Exception: ") + e.what());
+        return result;
+    } catch (...) {
+        result.set("error", "Unknown exception");
+        return result;
+    }
+}
 
-        QPainter painter(&image);
-        psdData->scene->render(&painter);
-        painter.end();
+static val idArray(const std::vector<int>& ids) {
+    val array = val::array();
+    for (int id : ids) array.call<void>("push", id);
+    return array;
+}
 
-        // Convert to RGBA8888
-        QImage rgbaImage = image.convertToFormat(QImage::Format_RGBA8888);
-        qsizetype byteCount = rgbaImage.sizeInBytes();
+// Visible leaf layers under a canvas point, topmost first. With alpha, only
+// layers with a non-transparent pixel there count.
+val hitTest(double handleD, int x, int y, bool alpha) {
+    val result = val::object();
+    int handle = static_cast<int>(handleD);
 
-        val Uint8ClampedArray = val::global("Uint8ClampedArray");
-        val data = Uint8ClampedArray.new_(static_cast<unsigned int>(byteCount));
-        val sourceView = val(typed_memory_view(byteCount, rgbaImage.constBits()));
-        data.call<void>("set", sourceView);
+    if (handle < 1 || handle >= 16 || s_parsers[handle] == nullptr) {
+        result.set("error", std::string("Invalid parser handle"));
+        return result;
+    }
+    PsdData* psdData = s_parsers[handle];
+    CallTimer callTimer(psdData->stats, StatHitTest);
 
-        result.set("width", width);
-        result.set("height", height);
-        result.set("data", data);
+    try {
+        result.set("layers", idArray(hitTestLayers(psdData, QPoint(x, y), alpha)));
+        return result;
+    } catch (const std::exception& e) {
+        result.set("error", std::string("Exception: ") + e.what());
+        return result;
+    } catch (...) {
+        result.set("error", "Unknown exception");
+        return result;
+    }
+}
+
+// Topmost visible layer with a non-transparent pixel at a canvas point, from
+// cached 1-bit coverage masks; layerId is -1 if there is none
+val hitTestPrecise(double handleD, int x, int y) {
+    val result = val::object();
+    int handle = static_cast<int>(handleD);
+
+    if (handle < 1 || handle >= 16 || s_parsers[handle] == nullptr) {
+        result.set("error", std::string("Invalid parser handle"));
+        return result;
+    }
+    PsdData* psdData = s_parsers[handle];
+    CallTimer callTimer(psdData->stats, StatHitTest);
+
+    try {
+        result.set("layerId", topmostCoveredLayer(psdData, QPoint(x, y)));
+        return result;
+    } catch (const std::exception& e) {
+        result.set("error", std::string("Exception: ") + e.what());
+        return result;
+    } catch (...) {
+        result.set("error", "Unknown exception");
+        return result;
+    }
+}
+
+// Visible leaf layers whose rect intersects the given canvas rect, topmost first
+val queryRegion(double handleD, int x, int y, int width, int height) {
+    val result = val::object();
+    int handle = static_cast<int>(handleD);
+
+    if (handle < 1 || handle >= 16 || s_parsers[handle] == nullptr) {
+        result.set("error", std::string("Invalid parser handle"));
+        return result;
+    }
+    PsdData* psdData = s_parsers[handle];
+    CallTimer callTimer(psdData->stats, StatHitTest);
+
+    try {
+        result.set("layers", idArray(queryLayerRegion(psdData, QRect(x, y, width, height))));
         return result;
     } catch (const std::exception& e) {
         result.set("error", std::string("Exception: ") + e.what());
@@ -595,19 +667,10 @@ val getLayerImage(double handleD, int layerId) {
         return result;
     }
     PsdData* psdData = s_parsers[handle];
+    CallTimer callTimer(psdData->stats, StatLayerImage);
 
     // Find layer by ID in exporter model
-    std::function<QModelIndex(const QModelIndex&)> findLayerById = [&](const QModelIndex& parent) -> QModelIndex {
-        for (int row = 0; row < psdData->exporterModel->rowCount(parent); ++row) {
-            auto index = psdData->exporterModel->index(row, 0, parent);
-            if (psdData->exporterModel->layerId(index) == layerId) return index;
-            auto found = findLayerById(index);
-            if (found.isValid()) return found;
-        }
-        return {};
-    };
-
-    QModelIndex index = findLayerById(QModelIndex());
+    QModelIndex index = findExporterIndex(psdData, layerId);
     if (!index.isValid()) {
         result.set("error", "Layer not found");
         return result;
@@ -628,23 +691,11 @@ val getLayerImage(double handleD, int layerId) {
         layerRect = item->rect();
     } else {
         // Folder: composite all visible children
-        const QRect bounds = computeBoundingRect(psdData->exporterModel.get(), index);
-        if (bounds.isEmpty()) {
+        layerImage = compositeFolder(psdData, index, layerRect);
+        if (layerRect.isEmpty()) {
             result.set("error", "Empty bounds");
             return result;
         }
-
-        QImage canvas(bounds.size(), QImage::Format_ARGB32);
-        canvas.fill(Qt::transparent);
-
-        QPainter painter(&canvas);
-        const auto blendMode = item->record().blendMode();
-        const bool passThrough = (blendMode == QPsdBlend::PassThrough);
-        compositeChildren(psdData->exporterModel.get(), index, painter, bounds.topLeft(), passThrough);
-        painter.end();
-
-        layerImage = canvas;
-        layerRect = bounds;
     }
 
     if (layerImage.isNull()) {
@@ -652,25 +703,23 @@ val getLayerImage(double handleD, int layerId) {
         return result;
     }
 
-    // Convert to RGBA8888
-    QImage rgbaImage = layerImage.convertToFormat(QImage::Format_RGBA8888);
-    qsizetype byteCount = rgbaImage.sizeInBytes();
-
-    val Uint8ClampedArray = val::global("Uint8ClampedArray");
-    val data = Uint8ClampedArray.new_(static_cast<unsigned int>(byteCount));
-    val sourceView = val(typed_memory_view(byteCount, rgbaImage.constBits()));
-    data.call<void>("set", sourceView);
-
-    result.set("width", rgbaImage.width());
-    result.set("height", rgbaImage.height());
+    result.set("width", layerImage.width());
+    result.set("height", layerImage.height());
     result.set("x", layerRect.x());
     result.set("y", layerRect.y());
-    result.set("data", data);
+    result.set("data", copyImageData(layerImage));
     return result;
 }
 
-// Export layer tree as JSON (ported from mcp-psd2x buildTree + get_layer_details)
-val exportLayerJson(double handleD) {
+// ========== Layer JSON export ==========
+
+// Reused between exports; released by trimMemory()
+static QByteArray s_jsonBuffer;
+
+// Export layer tree as JSON (ported from mcp-psd2x buildTree + get_layer_details).
+// Exports one subtree (rootLayerId < 0 for the whole document), down to
+// maxDepth levels (< 0 for unlimited), with the given LayerJsonField mask.
+val exportLayerJson(double handleD, int rootLayerId, int maxDepth, int fields) {
     val result = val::object();
     int handle = static_cast<int>(handleD);
 
@@ -679,100 +728,84 @@ val exportLayerJson(double handleD) {
         return result;
     }
     PsdData* psdData = s_parsers[handle];
+    CallTimer callTimer(psdData->stats, StatExportJson);
 
-    QJsonArray tree;
-    std::function<void(const QModelIndex&, QJsonArray&)> buildTree = [&](const QModelIndex& parent, QJsonArray& array) {
-        for (int row = 0; row < psdData->exporterModel->rowCount(parent); ++row) {
-            auto index = psdData->exporterModel->index(row, 0, parent);
-            QJsonObject obj;
-            obj["layerId"] = psdData->exporterModel->layerId(index);
-            obj["name"] = psdData->exporterModel->layerName(index);
-
-            const auto* item = psdData->exporterModel->layerItem(index);
-            if (item) {
-                obj["type"] = QString::fromStdString(itemTypeToString(item->type()));
-
-                const auto r = psdData->exporterModel->rect(index);
-                obj["rect"] = QJsonObject{
-                    {"x", r.x()}, {"y", r.y()},
-                    {"width", r.width()}, {"height", r.height()}
-                };
-                obj["opacity"] = item->opacity();
-                obj["fillOpacity"] = item->fillOpacity();
-                obj["visible"] = item->isVisible();
-
-                // Text content
-                if (item->type() == QPsdAbstractLayerItem::Text) {
-                    const auto* text = static_cast<const QPsdTextLayerItem*>(item);
-                    QJsonArray runs;
-                    for (const auto& run : text->runs()) {
-                        runs.append(QJsonObject{
-                            {"text", run.text},
-                            {"font", run.font.family()},
-                            {"originalFont", run.originalFontName},
-                            {"fontSize", run.font.pointSizeF()},
-                            {"color", run.color.name()},
-                        });
-                    }
-                    obj["runs"] = runs;
-                }
-
-                // Shape info
-                if (item->type() == QPsdAbstractLayerItem::Shape) {
-                    const auto* shape = static_cast<const QPsdShapeLayerItem*>(item);
-                    obj["brushColor"] = shape->brush().color().name();
-                    const auto pi = shape->pathInfo();
-                    static const char* pathTypes[] = {"none", "rectangle", "roundedRectangle", "path"};
-                    obj["pathType"] = QString::fromLatin1(pathTypes[pi.type]);
-                    if (pi.type == QPsdAbstractLayerItem::PathInfo::RoundedRectangle)
-                        obj["cornerRadius"] = pi.radius;
-                }
+    if (!writeDocumentJson(psdData, s_jsonBuffer, rootLayerId, maxDepth, fields)) {
+        result.set("error", "Layer not found");
+        return result;
+    }
+    addStat(&PsdStats::bytesCopied, double(s_jsonBuffer.size()));
+    result.set("json", val::u8string(s_jsonBuffer.constData()));
+    result.set("version", static_cast<double>(psdData->version));
+    return result;
+}
 
-                // Folder info
-                if (item->type() == QPsdAbstractLayerItem::Folder) {
-                    const auto* folder = static_cast<const QPsdFolderLayerItem*>(item);
-                    obj["childCount"] = psdData->exporterModel->rowCount(index);
-                    obj["isOpened"] = folder->isOpened();
-                }
+val exportLayerJson(double handleD) {
+    return exportLayerJson(handleD, -1, -1, JsonAllFields);
+}
 
-                // Image info
-                if (item->type() == QPsdAbstractLayerItem::Image) {
-                    const auto lf = item->linkedFile();
-                    if (!lf.name.isEmpty())
-                        obj["linkedFile"] = lf.name;
-                }
-            }
+// Export only the layers changed after sinceVersion, as a flat list without
+// children. Clients keep the returned version for the next call.
+val exportChangedLayersJson(double handleD, double sinceVersionD, int fields) {
+    val result = val::object();
+    int handle = static_cast<int>(handleD);
 
-            // Export hint
-            const auto hint = psdData->exporterModel->layerHint(index);
-            static const char* hintNames[] = {"embed", "merge", "custom", "native", "skip", "none"};
-            obj["hintType"] = QString::fromLatin1(hintNames[hint.type]);
-            obj["hintVisible"] = hint.visible;
-            if (!hint.properties.isEmpty()) {
-                QJsonArray propsArr;
-                for (const auto& prop : hint.properties)
-                    propsArr.append(prop);
-                obj["hintProperties"] = propsArr;
-            }
+    if (handle < 1 || handle >= 16 || s_parsers[handle] == nullptr) {
+        result.set("error", "Invalid parser handle");
+        return result;
+    }
+    PsdData* psdData = s_parsers[handle];
+    CallTimer callTimer(psdData->stats, StatExportJson);
+    const quint32 sinceVersion = static_cast<quint32>(sinceVersionD);
+
+    s_jsonBuffer.resize(0);
+    JsonWriter writer(s_jsonBuffer);
+    writer.beginObject();
+    writer.key("layers");
+    writer.beginArray();
+    // Oldest change first (then by id); QHash order differs between runs
+    std::vector<std::pair<quint32, int>> changed;
+    for (auto it = psdData->layerVersions.cbegin(); it != psdData->layerVersions.cend(); ++it) {
+        if (it.value() > sinceVersion) changed.push_back({ it.value(), it.key() });
+    }
+    std::sort(changed.begin(), changed.end());
+    for (const auto& [version, layerId] : changed) {
+        const QModelIndex index = findExporterIndex(psdData, layerId);
+        if (index.isValid())
+            writeLayerJson(writer, psdData, index, 0, 0, fields | JsonVersion);
+    }
+    writer.endArray();
+    writer.field("version", static_cast<double>(psdData->version));
+    writer.endObject();
 
-            if (psdData->exporterModel->rowCount(index) > 0) {
-                QJsonArray children;
-                buildTree(index, children);
-                obj["children"] = children;
-            }
+    addStat(&PsdStats::bytesCopied, double(s_jsonBuffer.size()));
+    result.set("json", val::u8string(s_jsonBuffer.constData()));
+    result.set("version", static_cast<double>(psdData->version));
+    return result;
+}
 
-            array.append(obj);
-        }
-    };
-    buildTree(QModelIndex(), tree);
+// Same as exportLayerJson, but returns a view of the UTF-8 output for
+// TextDecoder instead of a string. The view is only valid until the next
+// call into the module.
+val exportLayerJsonView(double handleD, int rootLayerId, int maxDepth, int fields) {
+    val result = val::object();
+    int handle = static_cast<int>(handleD);
 
-    QJsonObject root;
-    root["width"] = psdData->width;
-    root["height"] = psdData->height;
-    root["layers"] = tree;
+    if (handle < 1 || handle >= 16 || s_parsers[handle] == nullptr) {
+        result.set("error", "Invalid parser handle");
+        return result;
+    }
+    PsdData* psdData = s_parsers[handle];
+    CallTimer callTimer(psdData->stats, StatExportJson);
 
-    QJsonDocument doc(root);
-    result.set("json", doc.toJson(QJsonDocument::Compact).toStdString());
+    if (!writeDocumentJson(psdData, s_jsonBuffer, rootLayerId, maxDepth, fields)) {
+        result.set("error", "Layer not found");
+        return result;
+    }
+    addStat(&PsdStats::bytesCopied, double(s_jsonBuffer.size()));
+    result.set("data", val(typed_memory_view(s_jsonBuffer.size(),
+               reinterpret_cast<const unsigned char*>(s_jsonBuffer.constData()))));
+    result.set("version", static_cast<double>(psdData->version));
     return result;
 }
 
@@ -786,41 +819,9 @@ val getHintsJson(double handleD) {
         return result;
     }
     PsdData* psdData = s_parsers[handle];
+    CallTimer callTimer(psdData->stats, StatHints);
 
-    // Traverse all layers, collect non-default hints
-    QJsonObject layerHints;
-    std::function<void(const QModelIndex&)> traverse = [&](const QModelIndex& parent) {
-        for (int row = 0; row < psdData->exporterModel->rowCount(parent); ++row) {
-            auto index = psdData->exporterModel->index(row, 0, parent);
-            const auto* item = psdData->exporterModel->layerItem(index);
-            if (!item) continue;
-
-            const auto hint = psdData->exporterModel->layerHint(index);
-            if (!hint.isDefaultValue()) {
-                QJsonObject hintObj;
-                if (!hint.id.isEmpty()) hintObj["id"] = hint.id;
-                hintObj["type"] = static_cast<int>(hint.type);
-                if (!hint.componentName.isEmpty()) hintObj["name"] = hint.componentName;
-                hintObj["native"] = static_cast<int>(hint.baseElement);
-                hintObj["visible"] = hint.visible;
-                if (!hint.properties.isEmpty()) {
-                    QStringList propList = hint.properties.values();
-                    std::sort(propList.begin(), propList.end());
-                    hintObj["properties"] = QJsonArray::fromStringList(propList);
-                }
-                layerHints[QString::number(item->id())] = hintObj;
-            }
-            traverse(index);
-        }
-    };
-    traverse(QModelIndex());
-
-    QJsonObject root;
-    root["qtpsdparser.hint"] = 1;
-    root["layers"] = layerHints;
-
-    QJsonDocument doc(root);
-    result.set("json", doc.toJson(QJsonDocument::Compact).toStdString());
+    result.set("json", hintsToJson(psdData).toStdString());
     return result;
 }
 
@@ -834,54 +835,44 @@ val setHintsJson(double handleD, const std::string& jsonStr) {
         return result;
     }
     PsdData* psdData = s_parsers[handle];
+    CallTimer callTimer(psdData->stats, StatHints);
 
-    QJsonDocument doc = QJsonDocument::fromJson(QByteArray::fromStdString(jsonStr));
-    if (doc.isNull()) {
+    const int restored = hintsFromJson(psdData, QByteArray::fromStdString(jsonStr));
+    if (restored < 0) {
         result.set("error", "Invalid JSON");
         return result;
     }
 
-    QJsonObject root = doc.object();
-    QJsonObject layerHintsJson = root["layers"].toObject();
-
-    // Build a lookup from layer ID to model index
-    std::function<QModelIndex(int, const QModelIndex&)> findById = [&](int id, const QModelIndex& parent) -> QModelIndex {
-        for (int row = 0; row < psdData->exporterModel->rowCount(parent); ++row) {
-            auto index = psdData->exporterModel->index(row, 0, parent);
-            if (psdData->exporterModel->layerId(index) == id) return index;
-            auto found = findById(id, index);
-            if (found.isValid()) return found;
-        }
-        return {};
-    };
-
-    int restored = 0;
-    for (const auto& idStr : layerHintsJson.keys()) {
-        int layerId = idStr.toInt();
-        QModelIndex index = findById(layerId, QModelIndex());
-        if (!index.isValid()) continue;
+    result.set("restored", restored);
+    return result;
+}
 
-        QVariantMap settings = layerHintsJson[idStr].toObject().toVariantMap();
-        QStringList properties = settings.value("properties").toStringList();
+// Set text content on a text layer (for runtime dynamic text updates)
+val setLayerText(double handleD, int layerId, const std::string& text) {
+    val result = val::object();
+    int handle = static_cast<int>(handleD);
 
-        QPsdExporterTreeItemModel::ExportHint hint;
-        hint.id = settings.value("id").toString();
-        hint.type = static_cast<QPsdExporterTreeItemModel::ExportHint::Type>(settings.value("type").toInt());
-        hint.componentName = settings.value("name").toString();
-        hint.baseElement = static_cast<QPsdExporterTreeItemModel::ExportHint::NativeComponent>(settings.value("native").toInt());
-        hint.visible = settings.value("visible").toBool();
-        hint.properties = QSet<QString>(properties.begin(), properties.end());
+    if (handle < 1 || handle >= 16 || s_parsers[handle] == nullptr) {
+        result.set("error", "Invalid parser handle");
+        return result;
+    }
+    PsdData* psdData = s_parsers[handle];
+    CallTimer callTimer(psdData->stats, StatSetText);
 
-        psdData->exporterModel->setLayerHint(index, hint);
-        restored++;
+    std::string error;
+    if (!setTextLayerText(psdData, layerId, QString::fromStdString(text), error)) {
+        result.set("error", error);
+        return result;
     }
 
-    result.set("restored", restored);
+    result.set("ok", true);
     return result;
 }
 
-// Set text content on a text layer (for runtime dynamic text updates)
-val setLayerText(double handleD, int layerId, const std::string& text) {
+// Apply many text edits ([{id, text}, ...]) in one call. With render set,
+// also re-renders the area they touch once, with the visibility of the last
+// renderCompositeWithQt() call; the frame is returned with its x/y offset.
+val applyTextUpdates(double handleD, val updatesVal, bool render) {
     val result = val::object();
     int handle = static_cast<int>(handleD);
 
@@ -890,62 +881,277 @@ val setLayerText(double handleD, int layerId, const std::string& text) {
         return result;
     }
     PsdData* psdData = s_parsers[handle];
-
-    // Find layer by ID in widgetModel (scene uses this model for rendering)
-    std::function<QModelIndex(const QModelIndex&)> findLayerById = [&](const QModelIndex& parent) -> QModelIndex {
-        for (int row = 0; row < psdData->widgetModel->rowCount(parent); ++row) {
-            auto index = psdData->widgetModel->index(row, 0, parent);
-            if (psdData->widgetModel->layerId(index) == layerId) return index;
-            auto found = findLayerById(index);
-            if (found.isValid()) return found;
+    CallTimer callTimer(psdData->stats, StatTextUpdates);
+
+    int applied = 0;
+    QRect dirty;
+    val failed = val::array();
+    const int count = updatesVal["length"].as<int>();
+    for (int i = 0; i < count; ++i) {
+        const val update = updatesVal[i];
+        const int layerId = update["id"].as<int>();
+        std::string error;
+        if (setTextLayerText(psdData, layerId, QString::fromStdString(update["text"].as<std::string>()), error)) {
+            ++applied;
+            if (render) dirty |= textDirtyRect(psdData, layerId);
+        } else {
+            failed.call<void>("push", layerId);
         }
-        return {};
-    };
+    }
+    result.set("applied", applied);
+    result.set("failed", failed);
+
+    if (render && !dirty.isEmpty()) {
+        const QImage image = renderScene(psdData, psdData->sceneHiddenIds, psdData->sceneShownIds, dirty);
+        result.set("x", dirty.x());
+        result.set("y", dirty.y());
+        result.set("width", image.width());
+        result.set("height", image.height());
+        result.set("data", copyImageData(image));
+    }
+    return result;
+}
 
-    QModelIndex index = findLayerById(QModelIndex());
-    if (!index.isValid()) {
-        result.set("error", "Layer not found");
+// Apply the state delta in s_dataBuffer (visibility overrides and text, see
+// applyStateDelta()) and render once. The returned frame covers only the
+// changed area, with its x/y offset; no frame when nothing changed.
+// visibility lists the layers whose effective visibility flipped.
+val applyAndRender(double handleD, int deltaSize) {
+    val result = val::object();
+    int handle = static_cast<int>(handleD);
+
+    if (handle < 1 || handle >= 16 || s_parsers[handle] == nullptr) {
+        result.set("error", "Invalid parser handle");
+        return result;
+    }
+    if (deltaSize < 0 || deltaSize > s_dataBuffer.size()) {
+        result.set("error", "Invalid delta size");
         return result;
     }
+    PsdData* psdData = s_parsers[handle];
+    CallTimer callTimer(psdData->stats, StatApplyAndRender);
 
-    const auto* item = psdData->widgetModel->layerItem(index);
-    if (!item || item->type() != QPsdAbstractLayerItem::Text) {
-        result.set("error", "Layer is not a text layer");
+    try {
+        QRect dirty;
+        std::vector<LayerVisibility> changed;
+        std::string error;
+        if (!applyStateDelta(psdData, s_dataBuffer.constData(), deltaSize, dirty, changed, error)) {
+            result.set("error", error);
+            return result;
+        }
+        result.set("visibility", layerVisibilityArray(changed));
+        if (dirty.isEmpty()) return result;
+
+        // Full-canvas changes (visibility) may return to a cached state
+        const bool fullFrame = (dirty == QRect(0, 0, psdData->width, psdData->height));
+        const QImage image = fullFrame
+            ? compositeFrame(psdData, psdData->sceneHiddenIds, psdData->sceneShownIds)
+            : renderScene(psdData, psdData->sceneHiddenIds, psdData->sceneShownIds, dirty);
+        result.set("x", dirty.x());
+        result.set("y", dirty.y());
+        result.set("width", image.width());
+        result.set("height", image.height());
+        result.set("data", copyImageData(image));
+        return result;
+    } catch (const std::exception& e) {
+        result.set("error", std::string("Exception: ") + e.what());
+        return result;
+    } catch (...) {
+        result.set("error", "Unknown exception");
         return result;
     }
+}
 
-    // const_cast: QPsdTextItem::paint() reads runs() live on every render,
-    // so mutating here is picked up by the next renderCompositeWithQt() call.
-    auto* textItem = const_cast<QPsdTextLayerItem*>(
-        static_cast<const QPsdTextLayerItem*>(item));
+// Composite a visibility state into the frame cache without returning it,
+// so a later renderCompositeWithQt/applyAndRender for it is a copy. Meant
+// for idle time: likely next screens of a prototype. The overrides
+// ([{id, visible}, ...]) apply on top of the current ones for this only.
+val prerenderComposite(double handleD, val overridesVal) {
+    val result = val::object();
+    int handle = static_cast<int>(handleD);
 
-    auto runs = textItem->runs();
-    if (runs.isEmpty()) {
-        result.set("error", "Text layer has no runs");
+    try {
+        if (handle < 1 || handle >= 16 || s_parsers[handle] == nullptr) {
+            result.set("error", std::string("Invalid parser handle"));
+            return result;
+        }
+        PsdData* psdData = s_parsers[handle];
+        CallTimer callTimer(psdData->stats, StatPrerender);
+
+        std::vector<LayerVisibility> overrides;
+        const int count = overridesVal["length"].as<int>();
+        for (int i = 0; i < count; ++i) {
+            overrides.push_back({ overridesVal[i]["id"].as<int>(), overridesVal[i]["visible"].as<bool>() });
+        }
+
+        prerenderVisibility(psdData, overrides);
+        result.set("ok", true);
+        return result;
+    } catch (const std::exception& e) {
+        result.set("error", std::string("Exception: ") + e.what());
+        return result;
+    } catch (...) {
+        result.set("error", "Unknown exception");
         return result;
     }
+}
 
-    // Create new run with same styling as first run, but with new text
-    QPsdTextLayerItem::Run newRun = runs.first();
-    newRun.text = QString::fromStdString(text);
+// Layers whose effective visibility differs from their PSD flag, as
+// [{id, visible}, ...]: with the flags, the whole effective state
+val getVisibilityState(double handleD) {
+    val result = val::object();
+    int handle = static_cast<int>(handleD);
 
-    QList<QPsdTextLayerItem::Run> newRuns;
-    newRuns.append(newRun);
-    textItem->setRuns(newRuns);
+    if (handle < 1 || handle >= 16 || s_parsers[handle] == nullptr) {
+        result.set("error", std::string("Invalid parser handle"));
+        return result;
+    }
+    PsdData* psdData = s_parsers[handle];
+    ensureVisibilityTree(psdData);
 
-    result.set("ok", true);
+    std::vector<LayerVisibility> layers;
+    for (int id : psdData->sceneHiddenIds) layers.push_back({ id, false });
+    for (int id : psdData->sceneShownIds) layers.push_back({ id, true });
+    result.set("visibility", layerVisibilityArray(layers));
     return result;
 }
 
+// Byte budget for a document's cache of finished frames; 0 disables it
+void setCompositeCacheBudget(double handleD, double bytes) {
+    int handle = static_cast<int>(handleD);
+    if (handle >= 1 && handle < 16 && s_parsers[handle] != nullptr) {
+        setCompositeCacheBudget(s_parsers[handle], static_cast<qsizetype>(bytes));
+    }
+}
+
+// Layers the app changes at runtime; the rest is composited once into
+// cached planes. An empty array turns the split off.
+void setDynamicLayers(double handleD, val layerIdsVal) {
+    int handle = static_cast<int>(handleD);
+    if (handle < 1 || handle >= 16 || s_parsers[handle] == nullptr) return;
+
+    std::set<int> layerIds;
+    int count = layerIdsVal["length"].as<int>();
+    for (int i = 0; i < count; ++i) {
+        layerIds.insert(layerIdsVal[i].as<int>());
+    }
+    setDynamicLayers(s_parsers[handle], layerIds);
+}
+
 void releaseParser(double handleD) {
     int handle = static_cast<int>(handleD);
     if (handle >= 1 && handle < 16 && s_parsers[handle] != nullptr) {
-        QFile::remove(s_parsers[handle]->tempPath);
         delete s_parsers[handle];
         s_parsers[handle] = nullptr;
     }
 }
 
+// ========== Profiling ==========
+
+void setStatsEnabled(bool enabled) {
+    g_statsEnabled = enabled;
+}
+
+// Cumulative per-call counters for one document since load or resetStats()
+val getStats(double handleD) {
+    val result = val::object();
+    int handle = static_cast<int>(handleD);
+
+    if (handle < 1 || handle >= 16 || s_parsers[handle] == nullptr) {
+        result.set("error", "Invalid parser handle");
+        return result;
+    }
+    const PsdStats& stats = s_parsers[handle]->stats;
+
+    val calls = val::object();
+    for (int i = 0; i < StatEntryCount; ++i) {
+        val call = val::object();
+        call.set("count", stats.calls[i].count);
+        call.set("totalMs", stats.calls[i].totalMs);
+        call.set("maxMs", stats.calls[i].maxMs);
+        calls.set(statEntryNames[i], call);
+    }
+    result.set("enabled", g_statsEnabled);
+    result.set("calls", calls);
+    result.set("bytesCopied", stats.bytesCopied);
+    result.set("pixelsComposited", stats.pixelsComposited);
+    result.set("cacheHits", stats.cacheHits);
+    result.set("cacheMisses", stats.cacheMisses);
+    result.set("layersVisited", stats.layersVisited);
+    result.set("layersCulled", stats.layersCulled);
+    result.set("frameCacheHits", stats.frameCacheHits);
+    result.set("frameCacheMisses", stats.frameCacheMisses);
+    return result;
+}
+
+void resetStats(double handleD) {
+    int handle = static_cast<int>(handleD);
+    if (handle >= 1 && handle < 16 && s_parsers[handle] != nullptr) {
+        s_parsers[handle]->stats = PsdStats();
+    }
+}
+
+// ========== Static plugin registry ==========
+
+// List compiled-in plugins with the PSD tags each one handles (from the
+// plugin metadata keys, e.g. "lfx2", "TySh")
+val getStaticPlugins() {
+    val result = val::array();
+    for (const auto* entry = psdRunStaticPlugins; entry->name; ++entry) {
+        val plugin = val::object();
+        plugin.set("category", std::string(entry->category));
+        plugin.set("name", std::string(entry->name));
+        const QJsonObject metaData = entry->plugin().metaData().value("MetaData").toObject();
+        QStringList keys;
+        for (const auto& key : metaData.value("Keys").toArray())
+            keys.append(key.toString());
+        keys.sort();
+        val keysArray = val::array();
+        for (const auto& key : keys)
+            keysArray.call<void>("push", key.toStdString());
+        plugin.set("keys", keysArray);
+        result.call<void>("push", plugin);
+    }
+    return result;
+}
+
+// ========== Memory management ==========
+
+static int countParsers() {
+    int count = 0;
+    for (int i = 1; i < 16; i++) {
+        if (s_parsers[i] != nullptr) count++;
+    }
+    return count;
+}
+
+// Heap usage versus reserved linear memory. WASM memory never shrinks, so
+// heapSize only grows; "used" is what malloc currently hands out and
+// "free" is reserved memory available for reuse by later allocations.
+val getMemoryStats() {
+    val result = val::object();
+    const struct mallinfo info = mallinfo();
+    result.set("heapSize", static_cast<double>(emscripten_get_heap_size()));
+    result.set("heapMax", static_cast<double>(emscripten_get_heap_max()));
+    result.set("used", static_cast<double>(info.uordblks));
+    result.set("free", static_cast<double>(info.fordblks));
+    result.set("dataBuffer", static_cast<double>(s_dataBuffer.capacity()));
+    result.set("fontBuffer", static_cast<double>(s_fontBuffer.capacity()));
+    result.set("parsers", countParsers());
+    return result;
+}
+
+// Release transient buffers and return free pages at the top of the heap
+// to the allocator so they are reused before memory grows again. Documents
+// that stay open keep their frame caches; releaseParser() frees those.
+val trimMemory() {
+    s_dataBuffer = QByteArray();
+    s_fontBuffer = QByteArray();
+    s_jsonBuffer = QByteArray();
+    malloc_trim(0);
+    return getMemoryStats();
+}
+
 int main(int, char**) {
     ensureQtApp();
     return 0;
@@ -955,16 +1161,45 @@ EMSCRIPTEN_BINDINGS(psdrun_qt) {
     function("allocateBuffer", &allocateBuffer);
     function("getBufferView", &getBufferView);
     function("parsePsd", &parsePsd);
+    function("parsePsdCompact", &parsePsdCompact);
+    function("beginParse", &beginParse);
+    function("continueParse", &continueParse);
+    function("cancelParse", &cancelParse);
+    function("getLayerTable", &getLayerTable);
     function("renderCompositeWithQt", &renderCompositeWithQt);
+    function("getLayerOrdinals", &getLayerOrdinals);
+    function("renderCompositeWithStates", &renderCompositeWithStates);
     function("getLayerImage", &getLayerImage);
-    function("exportLayerJson", &exportLayerJson);
+    function("hitTest", &hitTest);
+    function("hitTestPrecise", &hitTestPrecise);
+    function("queryRegion", &queryRegion);
+    function("exportLayerJson", select_overload<val(double)>(&exportLayerJson));
+    function("exportLayerJson", select_overload<val(double, int, int, int)>(&exportLayerJson));
+    function("exportChangedLayersJson", &exportChangedLayersJson);
+    function("exportLayerJsonView", &exportLayerJsonView);
     function("getHintsJson", &getHintsJson);
     function("setHintsJson", &setHintsJson);
     function("setLayerText", &setLayerText);
+    function("applyTextUpdates", &applyTextUpdates);
+    function("applyAndRender", &applyAndRender);
+    function("prerenderComposite", &prerenderComposite);
+    function("getVisibilityState", &getVisibilityState);
+    function("setCompositeCacheBudget", select_overload<void(double, double)>(&setCompositeCacheBudget));
+    function("setDynamicLayers", select_overload<void(double, val)>(&setDynamicLayers));
     function("releaseParser", &releaseParser);
     // Font registration
     function("allocateFontBuffer", &allocateFontBuffer);
     function("getFontBufferView", &getFontBufferView);
     function("registerFont", &registerFont);
     function("getRegisteredFonts", &getRegisteredFonts);
+    // Diagnostics
+    function("getStaticPlugins", &getStaticPlugins);
+    function("getTimings", &getTimings);
+    function("clearTimings", &clearTimings);
+    function("setStatsEnabled", &setStatsEnabled);
+    function("getStats", &getStats);
+    function("resetStats", &resetStats);
+    // Memory management
+    function("getMemoryStats", &getMemoryStats);
+    function("trimMemory", &trimMemory);
 }
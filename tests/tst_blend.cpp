@@ -0,0 +1,164 @@
+// Copyright (C) 2026 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+//
+// blendLayer() kernels against QPainter's composition modes where both
+// implement the same W3C formula, and Photoshop's fill handling for the
+// "special eight" modes.
+
+#include <algorithm>
+#include <cstdlib>
+
+#include <QtCore/QRandomGenerator>
+#include <QtGui/QPainter>
+#include <QtTest/QTest>
+
+#include "psdrun_blend.h"
+
+class tst_Blend : public QObject {
+    Q_OBJECT
+
+private slots:
+    void matchesPainter_data();
+    void matchesPainter();
+    void specialFill_data();
+    void specialFill();
+    void fillScalesAlpha();
+};
+
+// Random colours and alpha, seeded so failures reproduce
+static QImage noise(int size, quint32 seed, bool opaque) {
+    QRandomGenerator random(seed);
+    QImage image(size, size, QImage::Format_ARGB32);
+    for (int y = 0; y < size; ++y) {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < size; ++x) {
+            const quint32 value = random.generate();
+            line[x] = opaque ? (value | 0xff000000u) : value;
+        }
+    }
+    return image;
+}
+
+// Largest per-channel difference of two images of the same size
+static int maxDifference(const QImage& a, const QImage& b) {
+    int worst = 0;
+    for (int y = 0; y < a.height(); ++y) {
+        const QRgb* lineA = reinterpret_cast<const QRgb*>(a.constScanLine(y));
+        const QRgb* lineB = reinterpret_cast<const QRgb*>(b.constScanLine(y));
+        for (int x = 0; x < a.width(); ++x) {
+            worst = std::max({ worst,
+                               std::abs(qRed(lineA[x]) - qRed(lineB[x])),
+                               std::abs(qGreen(lineA[x]) - qGreen(lineB[x])),
+                               std::abs(qBlue(lineA[x]) - qBlue(lineB[x])),
+                               std::abs(qAlpha(lineA[x]) - qAlpha(lineB[x])) });
+        }
+    }
+    return worst;
+}
+
+void tst_Blend::matchesPainter_data() {
+    // Enums as int: neither type is registered with the meta type system
+    QTest::addColumn<int>("mode");
+    QTest::addColumn<int>("composition");
+    QTest::addColumn<float>("opacity");
+
+    const struct {
+        const char* name;
+        QPsdBlend::Mode mode;
+        QPainter::CompositionMode composition;
+    } modes[] = {
+        { "normal", QPsdBlend::Normal, QPainter::CompositionMode_SourceOver },
+        { "multiply", QPsdBlend::Multiply, QPainter::CompositionMode_Multiply },
+        { "screen", QPsdBlend::Screen, QPainter::CompositionMode_Screen },
+        { "overlay", QPsdBlend::Overlay, QPainter::CompositionMode_Overlay },
+        { "darken", QPsdBlend::Darken, QPainter::CompositionMode_Darken },
+        { "lighten", QPsdBlend::Lighten, QPainter::CompositionMode_Lighten },
+        { "hard light", QPsdBlend::HardLight, QPainter::CompositionMode_HardLight },
+        { "difference", QPsdBlend::Difference, QPainter::CompositionMode_Difference },
+        { "exclusion", QPsdBlend::Exclusion, QPainter::CompositionMode_Exclusion },
+    };
+    for (const auto& entry : modes) {
+        QTest::addRow("%s", entry.name) << int(entry.mode) << int(entry.composition) << 1.0f;
+        QTest::addRow("%s, opacity 0.5", entry.name) << int(entry.mode) << int(entry.composition) << 0.5f;
+    }
+}
+
+void tst_Blend::matchesPainter() {
+    QFETCH(int, mode);
+    QFETCH(int, composition);
+    QFETCH(float, opacity);
+
+    const QImage backdrop = noise(64, 1, false);
+    const QImage source = noise(64, 2, false);
+
+    QImage blended = backdrop;
+    blendLayer(blended, QPoint(0, 0), source, QPsdBlend::Mode(mode), opacity, 1);
+
+    QImage reference = backdrop.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    QPainter painter(&reference);
+    painter.setCompositionMode(QPainter::CompositionMode(composition));
+    painter.setOpacity(opacity);
+    painter.drawImage(QPoint(0, 0), source);
+    painter.end();
+
+    // Compared premultiplied: colour is meaningless where alpha is near 0
+    const int difference = maxDifference(blended.convertToFormat(QImage::Format_ARGB32_Premultiplied),
+                                         reference);
+    QVERIFY2(difference <= 3, qPrintable(QStringLiteral("off by %1").arg(difference)));
+}
+
+void tst_Blend::specialFill_data() {
+    QTest::addColumn<int>("mode");
+    QTest::addColumn<float>("fill");
+
+    QTest::newRow("linear dodge, fill 0.5") << int(QPsdBlend::LinearDodge) << 0.5f;
+    QTest::newRow("linear dodge, fill 0.25") << int(QPsdBlend::LinearDodge) << 0.25f;
+    QTest::newRow("difference, fill 0.5") << int(QPsdBlend::Difference) << 0.5f;
+}
+
+// Opaque layer over an opaque backdrop: the result is the blend result
+// pulled towards the backdrop by fill, Cb + fill * (B - Cb)
+void tst_Blend::specialFill() {
+    QFETCH(int, mode);
+    QFETCH(float, fill);
+
+    const QImage backdrop = noise(32, 3, true);
+    const QImage source = noise(32, 4, true);
+
+    QImage blended = backdrop;
+    blendLayer(blended, QPoint(0, 0), source, QPsdBlend::Mode(mode), 1, fill);
+
+    auto expected = [&](int cb, int cs) {
+        const float b = mode == QPsdBlend::LinearDodge ? std::min(255, cb + cs) : std::abs(cb - cs);
+        return int(cb + fill * (b - cb) + 0.5f);
+    };
+    int worst = 0;
+    for (int y = 0; y < backdrop.height(); ++y) {
+        for (int x = 0; x < backdrop.width(); ++x) {
+            const QRgb cb = backdrop.pixel(x, y);
+            const QRgb cs = source.pixel(x, y);
+            const QRgb out = blended.pixel(x, y);
+            worst = std::max({ worst,
+                               std::abs(qRed(out) - expected(qRed(cb), qRed(cs))),
+                               std::abs(qGreen(out) - expected(qGreen(cb), qGreen(cs))),
+                               std::abs(qBlue(out) - expected(qBlue(cb), qBlue(cs))) });
+            QCOMPARE(qAlpha(out), 255);
+        }
+    }
+    QVERIFY2(worst <= 1, qPrintable(QStringLiteral("off by %1").arg(worst)));
+}
+
+// Outside the special eight, fill is just another opacity
+void tst_Blend::fillScalesAlpha() {
+    const QImage backdrop = noise(32, 5, false);
+    const QImage source = noise(32, 6, false);
+
+    QImage byFill = backdrop;
+    blendLayer(byFill, QPoint(0, 0), source, QPsdBlend::Multiply, 1, 0.5f);
+    QImage byOpacity = backdrop;
+    blendLayer(byOpacity, QPoint(0, 0), source, QPsdBlend::Multiply, 0.5f, 1);
+    QCOMPARE(byFill, byOpacity);
+}
+
+QTEST_MAIN(tst_Blend)
+#include "tst_blend.moc"
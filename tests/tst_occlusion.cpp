@@ -0,0 +1,125 @@
+// Copyright (C) 2026 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+//
+// Occlusion culling in renderScene() must never change the composite:
+// psdgen documents where opaque layers inside clipped layers or masked
+// folders cover visible lower layers are rendered with culling and
+// compared to a plain scene render.
+
+#include <QtCore/QProcess>
+#include <QtCore/QTemporaryDir>
+#include <QtGui/QPainter>
+#include <QtTest/QTest>
+
+#include "psdrun_core.h"
+
+#ifndef PSDRUN_PSDGEN
+#define PSDRUN_PSDGEN "psdgen"
+#endif
+
+// The document shapes culling has to leave alone
+enum class Scenario { ClippedLayer, MaskedFolder };
+Q_DECLARE_METATYPE(Scenario)
+
+class tst_Occlusion : public QObject {
+    Q_OBJECT
+
+private slots:
+    void cullingKeepsComposite_data();
+    void cullingKeepsComposite();
+
+private:
+    QTemporaryDir m_dir;
+};
+
+static bool isLeaf(const QPsdAbstractLayerItem* item) {
+    return item && item->type() != QPsdAbstractLayerItem::Folder;
+}
+
+// Visible leaves of a folder, at any depth
+static void collectLeaves(const QPsdWidgetTreeItemModel* model, const QModelIndex& parent,
+                          std::vector<const QPsdAbstractLayerItem*>& leaves) {
+    for (int row = 0; row < model->rowCount(parent); ++row) {
+        const QModelIndex index = model->index(row, 0, parent);
+        const auto* item = model->layerItem(index);
+        if (!item || !item->isVisible()) continue;
+        if (isLeaf(item)) leaves.push_back(item);
+        else collectLeaves(model, index, leaves);
+    }
+}
+
+// True if an opaque layer inside a clipped layer (ClippedLayer) or a masked
+// folder (MaskedFolder) fully covers a visible top-level layer below it, the
+// case a wrong occluder would cull
+static bool hasCase(const QPsdWidgetTreeItemModel* model, Scenario scenario) {
+    const int count = model->rowCount();
+    for (int row = 0; row < count; ++row) {
+        const QModelIndex index = model->index(row, 0);
+        const auto* item = model->layerItem(index);
+        if (!item || !item->isVisible()) continue;
+
+        std::vector<const QPsdAbstractLayerItem*> covering;
+        if (scenario == Scenario::ClippedLayer) {
+            if (isLeaf(item) && item->record().clipping() == QPsdLayerRecord::NonBase)
+                covering.push_back(item);
+        } else if (!isLeaf(item) && !item->layerMask().isNull()) {
+            collectLeaves(model, index, covering);
+        }
+
+        for (int below = row + 1; below < count; ++below) {
+            const auto* lower = model->layerItem(model->index(below, 0));
+            if (!isLeaf(lower) || !lower->isVisible()) continue;
+            for (const auto* upper : covering) {
+                if (upper->rect().contains(lower->rect()))
+                    return true;
+            }
+        }
+    }
+    return false;
+}
+
+void tst_Occlusion::cullingKeepsComposite_data() {
+    QTest::addColumn<Scenario>("scenario");
+    QTest::addColumn<QStringList>("options");
+
+    QTest::newRow("clipped layer") << Scenario::ClippedLayer
+        << QStringList { "--layers", "24", "--clip-ratio", "0.5" };
+    QTest::newRow("masked folder") << Scenario::MaskedFolder
+        << QStringList { "--layers", "24", "--groups", "4", "--depth", "1", "--group-mask-ratio", "1" };
+}
+
+void tst_Occlusion::cullingKeepsComposite() {
+    QFETCH(Scenario, scenario);
+    QFETCH(QStringList, options);
+    QVERIFY(m_dir.isValid());
+
+    bool covered = false;
+    for (int seed = 1; seed <= 32; ++seed) {
+        const QString path = m_dir.filePath(QStringLiteral("%1-%2.psd")
+                                                .arg(QTest::currentDataTag()).arg(seed));
+        const int status = QProcess::execute(QStringLiteral(PSDRUN_PSDGEN), QStringList {
+            "--width", "256", "--height", "256", "--translucent-ratio", "0",
+            "--seed", QString::number(seed), "-o", path } + options);
+        QCOMPARE(status, 0);
+
+        std::string error;
+        std::unique_ptr<PsdData> psdData(loadPsdFile(path, error));
+        QVERIFY2(psdData, error.c_str());
+        covered = covered || hasCase(psdData->widgetModel.get(), scenario);
+
+        // Reference: every visible item, nothing culled
+        QImage reference(psdData->width, psdData->height, QImage::Format_ARGB32_Premultiplied);
+        reference.fill(Qt::transparent);
+        QPainter painter(&reference);
+        psdData->scene->render(&painter);
+        painter.end();
+
+        const QImage culled = renderScene(psdData.get(), {}, {});
+        QVERIFY2(culled == reference, qPrintable(QStringLiteral("seed %1").arg(seed)));
+    }
+    // The corpus must contain the case under test
+    QVERIFY(covered);
+}
+
+QTEST_MAIN(tst_Occlusion)
+#include "tst_occlusion.moc"
@@ -0,0 +1,696 @@
+// Copyright (C) 2026 Signal Slot Inc.
+// SPDX-License-Identifier: LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+//
+// psdgen - writes parametric synthetic PSDs for scaling tests and the
+// benchmark corpus: many layers, deep group nesting, large canvases and
+// large raster masks. Output is deterministic for a given seed.
+//
+// Usage:
+//   psdgen [options] -o out.psd
+//   psdgen --preset deep-nesting -o deep-nesting.psd
+//   psdgen --all-presets bench/corpus
+//
+// Layers are solid-colour raster layers (opaque or with an alpha ramp),
+// optionally masked by an ellipse, clipped to the layer below, hidden or
+// using a non-normal blend mode. Groups are written as lsct folder/divider
+// pairs and can be masked and clipped too. Text layers are point text (TySh
+// with EngineData) in one or more style runs, with transparent pixel data;
+// psd-run renders them from the runs. The merged image is a flat white
+// placeholder; psd-run composites from the layers.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDataStream>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QRect>
+#include <QtCore/QStringList>
+
+namespace {
+
+struct Params {
+    int width = 1920;
+    int height = 1080;
+    int layers = 100;          // raster layers
+    int groups = 0;            // folders; at least depth
+    int depth = 0;             // deepest folder nesting, at least 1 with groups
+    double maskRatio = 0;      // fraction of layers with a raster mask
+    bool canvasMasks = false;  // masks span the whole canvas instead of the layer
+    double hiddenRatio = 0;
+    double translucentRatio = 0.5;  // layers with an alpha ramp instead of opaque
+    double clipRatio = 0;      // layers and groups clipped to the layer below
+    double groupMaskRatio = 0; // fraction of groups with an ellipse raster mask
+    double textRatio = 0;      // fraction of layers that are text layers
+    int textRuns = 1;          // maximum style runs per text layer
+    bool mixedBlend = false;
+    quint32 seed = 1;
+};
+
+struct Preset {
+    const char* name;
+    const char* description;
+    Params params;
+};
+
+Params preset(int width, int height, int layers, int groups, int depth) {
+    Params p;
+    p.width = width;
+    p.height = height;
+    p.layers = layers;
+    p.groups = groups;
+    p.depth = depth;
+    return p;
+}
+
+// Benchmark corpus; keep in sync with PSDRUN_BENCH_PRESETS in CMakeLists.txt
+const std::vector<Preset>& presets() {
+    static const std::vector<Preset> list = [] {
+        std::vector<Preset> result;
+        result.push_back({ "many-layers", "10k raster layers, flat", preset(2048, 1536, 10000, 0, 0) });
+        result.push_back({ "deep-nesting", "20-level nested groups", preset(1920, 1080, 400, 60, 20) });
+        result.push_back({ "big-canvas", "16384x16384 canvas", preset(16384, 16384, 64, 4, 1) });
+        Params masks = preset(4096, 4096, 32, 0, 0);
+        masks.maskRatio = 1;
+        masks.canvasMasks = true;
+        result.push_back({ "big-masks", "canvas-sized masks on every layer", masks });
+        Params mixed = preset(1920, 1080, 1000, 80, 4);
+        mixed.maskRatio = 0.2;
+        mixed.hiddenRatio = 0.1;
+        mixed.mixedBlend = true;
+        result.push_back({ "mixed", "groups, masks, hidden layers and blend modes", mixed });
+        Params texts = preset(1920, 1080, 3000, 40, 2);
+        texts.textRatio = 0.8;
+        texts.textRuns = 6;
+        result.push_back({ "many-texts", "~2400 text layers, up to 6 style runs each", texts });
+        return result;
+    }();
+    return list;
+}
+
+struct Node {
+    bool group = false;
+    int parent = -1;
+    int nesting = 0;
+    std::vector<int> children;  // top to bottom
+    QString name;
+    QRect rect;
+    QRect maskRect;             // empty without mask
+    quint8 color[3] = {};
+    bool translucent = false;
+    bool hidden = false;
+    bool clipped = false;
+    QByteArray blendKey = "norm";
+    // Text layers only: content (empty for raster layers), size in points
+    // and where each style run ends (exclusive, in characters)
+    QString text;
+    int fontSize = 0;
+    std::vector<int> runEnds;
+};
+
+class Rng {
+public:
+    explicit Rng(quint32 seed) : m_engine(seed) {}
+    // std::mt19937 is specified exactly, unlike the standard distributions
+    int range(int lo, int hi) { return lo + int(m_engine() % quint32(hi - lo + 1)); }
+    bool chance(double ratio) { return m_engine() < ratio * 4294967296.0; }
+
+private:
+    std::mt19937 m_engine;
+};
+
+// Turn node into a point text layer: a few words in up to p.textRuns style
+// runs, with a rect estimated from the font size
+void makeText(Node& node, int index, const Params& p, Rng& rng) {
+    static const char* const words[] = {
+        "Temperature", "Speed", "Volume", "Mode", "Status", "Battery", "Range", "Eco", "Trip", "Auto",
+    };
+    QStringList parts { QString::number(index + 1) };
+    for (int w = rng.range(1, 5); w > 0; --w)
+        parts.append(QLatin1String(words[rng.range(0, int(std::size(words)) - 1)]));
+    node.text = parts.join(QLatin1Char(' '));
+    node.name = node.text;
+    node.fontSize = rng.range(10, 48);
+
+    const int length = int(node.text.size());
+    const int runs = std::min(rng.range(1, std::max(1, p.textRuns)), length);
+    for (int r = 1; r <= runs; ++r)
+        node.runEnds.push_back(length * r / runs);
+
+    const int w = std::min(p.width, int(std::ceil(length * node.fontSize * 0.55)));
+    const int h = std::min(p.height, int(std::ceil(node.fontSize * 1.25)));
+    node.rect = QRect(rng.range(0, p.width - w), rng.range(0, p.height - h), w, h);
+}
+
+std::vector<Node> buildTree(const Params& p) {
+    Rng rng(p.seed);
+    std::vector<Node> nodes(1);  // node 0 is the document root
+    nodes[0].group = true;
+
+    const int minSide = std::max(1, std::min(p.width, p.height) / 16);
+    const int maxSide = std::max(minSide, std::min(p.width, p.height) / 3);
+
+    // Groups need at least one level to live in; depth 0 means top level only
+    const int depth = p.groups > 0 ? std::max(p.depth, 1) : p.depth;
+    const int groups = std::max(p.groups, depth);
+    for (int i = 0; i < groups; ++i) {
+        Node node;
+        node.group = true;
+        node.name = QStringLiteral("Group %1").arg(i + 1);
+        node.hidden = p.hiddenRatio > 0 && rng.chance(p.hiddenRatio / 2);
+        node.clipped = p.clipRatio > 0 && rng.chance(p.clipRatio);
+        if (p.groupMaskRatio > 0 && rng.chance(p.groupMaskRatio)) {
+            const int w = rng.range(minSide, maxSide);
+            const int h = rng.range(minSide, maxSide);
+            node.maskRect = QRect(rng.range(0, p.width - w), rng.range(0, p.height - h), w, h);
+        }
+        // The first depth groups form a chain so the nesting limit is reached
+        if (i < depth) {
+            node.parent = i;
+        } else {
+            do {
+                node.parent = rng.range(0, int(nodes.size()) - 1);
+            } while (nodes[node.parent].nesting >= depth);
+        }
+        node.nesting = nodes[node.parent].nesting + 1;
+        nodes[node.parent].children.push_back(int(nodes.size()));
+        nodes.push_back(node);
+    }
+
+    static const char* const blendKeys[] = { "mul ", "scrn", "over", "lddg", "diff", "lum " };
+    for (int i = 0; i < p.layers; ++i) {
+        Node node;
+        node.name = QStringLiteral("Layer %1").arg(i + 1);
+        node.parent = rng.range(0, int(nodes.size()) - 1);
+        while (!nodes[node.parent].group)
+            node.parent = nodes[node.parent].parent;
+        const int w = rng.range(minSide, maxSide);
+        const int h = rng.range(minSide, maxSide);
+        node.rect = QRect(rng.range(0, p.width - w), rng.range(0, p.height - h), w, h);
+        for (auto& c : node.color)
+            c = quint8(rng.range(0, 255));
+        if (p.textRatio > 0 && rng.chance(p.textRatio))
+            makeText(node, i, p, rng);
+        node.translucent = rng.chance(p.translucentRatio);
+        node.hidden = rng.chance(p.hiddenRatio);
+        node.clipped = p.clipRatio > 0 && rng.chance(p.clipRatio);
+        if (p.mixedBlend && rng.chance(0.3))
+            node.blendKey = blendKeys[rng.range(0, int(std::size(blendKeys)) - 1)];
+        if (rng.chance(p.maskRatio))
+            node.maskRect = p.canvasMasks ? QRect(0, 0, p.width, p.height) : node.rect;
+        node.nesting = nodes[node.parent].nesting + 1;
+        nodes[node.parent].children.push_back(int(nodes.size()));
+        nodes.push_back(node);
+    }
+    // The bottom layer of a group has nothing to clip to
+    for (auto& node : nodes) {
+        if (node.group && !node.children.empty())
+            nodes[node.children.back()].clipped = false;
+    }
+    return nodes;
+}
+
+// PackBits (RLE) encoding of one row, as used by PSD compression 1
+void packBits(const uchar* src, int n, QByteArray& out) {
+    int i = 0;
+    while (i < n) {
+        int run = 1;
+        while (i + run < n && run < 128 && src[i + run] == src[i])
+            ++run;
+        if (run >= 2) {
+            out.append(char(1 - run));
+            out.append(char(src[i]));
+            i += run;
+            continue;
+        }
+        const int start = i++;
+        while (i < n && i - start < 128 && !(i + 1 < n && src[i] == src[i + 1]))
+            ++i;
+        out.append(char(i - start - 1));
+        out.append(reinterpret_cast<const char*>(src) + start, i - start);
+    }
+}
+
+// Compressed channel: compression 1, per-row byte counts, PackBits rows.
+// fillRow writes the bytes of row y; rows equal to the previous one are
+// encoded once.
+template <typename FillRow>
+QByteArray encodeChannel(int width, int height, FillRow fillRow) {
+    QByteArray counts;
+    QByteArray data;
+    QByteArray row(width, 0);
+    QByteArray previous;
+    QByteArray encoded;
+    for (int y = 0; y < height; ++y) {
+        fillRow(y, reinterpret_cast<uchar*>(row.data()));
+        if (row != previous) {
+            encoded.clear();
+            packBits(reinterpret_cast<const uchar*>(row.constData()), width, encoded);
+            previous = row;
+        }
+        counts.append(char(encoded.size() >> 8)).append(char(encoded.size() & 0xff));
+        data.append(encoded);
+    }
+    QByteArray channel;
+    channel.reserve(2 + counts.size() + data.size());
+    channel.append('\0').append('\1').append(counts).append(data);
+    return channel;
+}
+
+void fillEllipseRow(const QRect& rect, int y, uchar* row) {
+    const double ry = rect.height() / 2.0;
+    const double dy = (y + 0.5 - ry) / ry;
+    const double half = dy * dy < 1 ? rect.width() / 2.0 * std::sqrt(1 - dy * dy) : 0;
+    const double cx = rect.width() / 2.0;
+    for (int x = 0; x < rect.width(); ++x)
+        row[x] = (x + 0.5 > cx - half && x + 0.5 < cx + half) ? 255 : 0;
+}
+
+// ---------- Text layers ----------
+
+// EngineData string: UTF-16BE with byte order mark, (, ) and \ escaped
+QByteArray engineString(const QString& text) {
+    QByteArray out("(\xfe\xff");
+    for (QChar ch : text) {
+        for (char byte : { char(ch.unicode() >> 8), char(ch.unicode() & 0xff) }) {
+            if (byte == '(' || byte == ')' || byte == '\\')
+                out.append('\\');
+            out.append(byte);
+        }
+    }
+    return out.append(')');
+}
+
+QByteArray engineNumber(double value) {
+    return QByteArray::number(value, 'f', 5);
+}
+
+// EngineData of a point text layer: the text (terminated by a carriage
+// return, as Photoshop stores it) and one style run per node.runEnds entry,
+// all in ArialMT with colours stepped from the node colour
+QByteArray engineData(const Node& node) {
+    QByteArray styleRuns;
+    QByteArray runLengths;
+    int start = 0;
+    for (size_t r = 0; r < node.runEnds.size(); ++r) {
+        const bool last = r + 1 == node.runEnds.size();
+        const int length = node.runEnds[r] - start + (last ? 1 : 0);
+        start = node.runEnds[r];
+        QByteArray color;
+        for (quint8 c : node.color)
+            color += ' ' + engineNumber(quint8(c + 48 * r) / 255.0);
+        styleRuns += "<< /StyleSheet << /StyleSheetData << /Font 0 /FontSize "
+            + engineNumber(node.fontSize + 2 * int(r))
+            + " /FillColor << /Type 1 /Values [ 1.0" + color + " ] >> >> >> >> ";
+        runLengths += QByteArray::number(length) + ' ';
+    }
+    const QByteArray paragraph =
+        "<< /ParagraphSheet << /DefaultStyleSheet 0 /Properties << /Justification 0 >> >>"
+        " /Adjustments << /Axis [ 1.0 0.0 1.0 ] /XY [ 0.0 0.0 ] >> >>";
+    const QByteArray resources =
+        "<<\n/FontSet [ << /Name " + engineString(QStringLiteral("ArialMT"))
+        + " /Script 0 /FontType 1 /Synthetic 0 >> ]\n"
+        "/StyleSheetSet [ << /Name " + engineString(QStringLiteral("Normal RGB"))
+        + " /StyleSheetData << /Font 0 /FontSize 12.0 /FillColor << /Type 1 /Values [ 1.0 0.0 0.0 0.0 ] >> >> >> ]\n"
+        "/ParagraphSheetSet [ << /Name " + engineString(QStringLiteral("Normal RGB"))
+        + " /DefaultStyleSheet 0 /Properties << /Justification 0 >> >> ]\n>>";
+
+    return "\n\n<<\n/EngineDict\n<<\n"
+        "/Editor << /Text " + engineString(node.text + QLatin1Char('\r')) + " >>\n"
+        "/ParagraphRun << /DefaultRunData " + paragraph + " /RunArray [ " + paragraph
+        + " ] /RunLengthArray [ " + QByteArray::number(node.text.size() + 1) + " ] /IsJoinable 1 >>\n"
+        "/StyleRun << /DefaultRunData << /StyleSheet << /StyleSheetData << >> >> >>"
+        " /RunArray [ " + styleRuns + "] /RunLengthArray [ " + runLengths + "] /IsJoinable 2 >>\n"
+        "/AntiAlias 4\n/UseFractionalGlyphWidths true\n"
+        "/Rendered << /Version 1 /Shapes << /WritingDirection 0 /Children [ << /ShapeType 0"
+        " /Procession 0 /Lines << /WritingDirection 0 /Children [ ] >> >> ] >> >>\n"
+        ">>\n/ResourceDict\n" + resources + "\n/DocumentResources\n" + resources + "\n>>";
+}
+
+// Action descriptor pieces, as used by the TySh text and warp data
+void descriptorKey(QDataStream& d, const QByteArray& key) {
+    d << quint32(key.size() == 4 ? 0 : key.size());
+    d.writeRawData(key.constData(), key.size());
+}
+
+void descriptorHeader(QDataStream& d, const QByteArray& classId, int items) {
+    d << quint32(1) << quint16(0);  // empty class name
+    descriptorKey(d, classId);
+    d << quint32(items);
+}
+
+void descriptorEnum(QDataStream& d, const QByteArray& key, const QByteArray& type, const QByteArray& value) {
+    descriptorKey(d, key);
+    d.writeRawData("enum", 4);
+    descriptorKey(d, type);
+    descriptorKey(d, value);
+}
+
+void descriptorDouble(QDataStream& d, const QByteArray& key, double value) {
+    descriptorKey(d, key);
+    d.writeRawData("doub", 4);
+    d << value;
+}
+
+// Left/Top/Rght/Btom in points, relative to the text origin
+void descriptorBounds(QDataStream& d, const QByteArray& key, const QRectF& r) {
+    descriptorKey(d, key);
+    d.writeRawData("Objc", 4);
+    descriptorHeader(d, "bounds", 4);
+    const std::pair<const char*, double> sides[] = {
+        { "Left", r.left() }, { "Top ", r.top() }, { "Rght", r.right() }, { "Btom", r.bottom() },
+    };
+    for (const auto& [side, value] : sides) {
+        descriptorKey(d, side);
+        d.writeRawData("UntF", 4);
+        d.writeRawData("#Pnt", 4);
+        d << value;
+    }
+}
+
+// Type tool object setting (TySh): transform placing the baseline origin,
+// text descriptor with the EngineData, an empty warp and the text bounds
+void writeTypeTool(QDataStream& d, const Node& node) {
+    const QRect& r = node.rect;
+    const double ascent = node.fontSize;
+    d << quint16(1);
+    for (double value : { 1.0, 0.0, 0.0, 1.0, double(r.left()), r.top() + ascent })
+        d << value;
+
+    d << quint16(50) << quint32(16);
+    descriptorHeader(d, "TxLr", 7);
+    descriptorKey(d, "Txt ");
+    d.writeRawData("TEXT", 4);
+    d << quint32(node.text.size() + 1);
+    for (QChar ch : node.text)
+        d << quint16(ch.unicode());
+    d << quint16(0);
+    descriptorEnum(d, "textGridding", "textGridding", "None");
+    descriptorEnum(d, "Ornt", "Ornt", "Hrzn");
+    descriptorEnum(d, "AntA", "Annt", "antiAliasSharp");
+    const QRectF bounds(0, -ascent, r.width(), r.height());
+    descriptorBounds(d, "bounds", bounds);
+    descriptorBounds(d, "boundingBox", bounds);
+    const QByteArray engine = engineData(node);
+    descriptorKey(d, "EngineData");
+    d.writeRawData("tdta", 4);
+    d << quint32(engine.size());
+    d.writeRawData(engine.constData(), engine.size());
+
+    d << quint16(1) << quint32(16);
+    descriptorHeader(d, "warp", 5);
+    descriptorEnum(d, "warpStyle", "warpStyle", "warpNone");
+    descriptorDouble(d, "warpValue", 0);
+    descriptorDouble(d, "warpPerspective", 0);
+    descriptorDouble(d, "warpPerspectiveOther", 0);
+    descriptorEnum(d, "warpRotate", "Ornt", "Hrzn");
+
+    d << qint32(r.left()) << qint32(r.top()) << qint32(r.right() + 1) << qint32(r.bottom() + 1);
+}
+
+class Writer {
+public:
+    explicit Writer(QDataStream& out) : m_out(out) {}
+
+    void beginRecord(const Node& node, const QRect& rect, const QList<QPair<qint16, QByteArray>>& channels) {
+        m_out << qint32(rect.top()) << qint32(rect.left())
+              << qint32(rect.top() + rect.height()) << qint32(rect.left() + rect.width());
+        m_out << quint16(channels.size());
+        for (const auto& channel : channels)
+            m_out << channel.first << quint32(channel.second.size());
+        m_out.writeRawData("8BIM", 4);
+        m_out.writeRawData(node.group ? "pass" : node.blendKey.constData(), 4);
+        m_out << quint8(255) << quint8(node.clipped ? 1 : 0)
+              << quint8((node.hidden ? 0x02 : 0) | 0x08 | (node.group ? 0x10 : 0)) << quint8(0);
+    }
+
+    void extraData(const Node& node, const QString& name, int sectionType, quint32 layerId) {
+        QByteArray extra;
+        QDataStream e(&extra, QIODevice::WriteOnly);
+
+        // Layer mask data
+        if (!node.maskRect.isEmpty()) {
+            const QRect& m = node.maskRect;
+            e << quint32(20) << qint32(m.top()) << qint32(m.left())
+              << qint32(m.top() + m.height()) << qint32(m.left() + m.width())
+              << quint8(0) << quint8(0) << quint16(0);
+        } else {
+            e << quint32(0);
+        }
+        // Blending ranges
+        e << quint32(0);
+        // Pascal name padded to a multiple of 4
+        const QByteArray latin = name.toLatin1().left(255);
+        e << quint8(latin.size());
+        e.writeRawData(latin.constData(), latin.size());
+        for (int pad = (1 + latin.size()) % 4; pad && pad < 4; ++pad)
+            e << quint8(0);
+
+        taggedBlock(e, "luni", [&](QDataStream& d) {
+            d << quint32(name.size());
+            for (QChar ch : name)
+                d << quint16(ch.unicode());
+        });
+        taggedBlock(e, "lyid", [&](QDataStream& d) { d << layerId; });
+        if (!node.text.isEmpty())
+            taggedBlock(e, "TySh", [&](QDataStream& d) { writeTypeTool(d, node); });
+        if (sectionType >= 0) {
+            taggedBlock(e, "lsct", [&](QDataStream& d) {
+                d << quint32(sectionType);
+                if (sectionType != 3) {
+                    d.writeRawData("8BIM", 4);
+                    d.writeRawData("pass", 4);
+                }
+            });
+        }
+
+        m_out << quint32(extra.size());
+        m_out.writeRawData(extra.constData(), extra.size());
+    }
+
+private:
+    template <typename Body>
+    static void taggedBlock(QDataStream& e, const char* key, Body body) {
+        QByteArray data;
+        QDataStream d(&data, QIODevice::WriteOnly);
+        body(d);
+        while (data.size() % 4)
+            data.append('\0');
+        e.writeRawData("8BIM", 4);
+        e.writeRawData(key, 4);
+        e << quint32(data.size());
+        e.writeRawData(data.constData(), data.size());
+    }
+
+    QDataStream& m_out;
+};
+
+bool writePsd(const QString& path, const Params& p) {
+    if (p.width < 1 || p.height < 1 || p.width > 30000 || p.height > 30000) {
+        std::fprintf(stderr, "Canvas must be 1..30000 pixels per side\n");
+        return false;
+    }
+    const std::vector<Node> nodes = buildTree(p);
+
+    // Layer records are stored bottom to top: a folder is written as its
+    // divider, its children, then the folder record itself.
+    struct Entry { int node; bool divider; };
+    std::vector<Entry> order;
+    std::function<void(int)> emit = [&](int n) {
+        const Node& node = nodes[n];
+        if (node.group && n != 0)
+            order.push_back({ n, true });
+        for (auto it = node.children.rbegin(); it != node.children.rend(); ++it)
+            emit(*it);
+        if (n != 0)
+            order.push_back({ n, false });
+    };
+    emit(0);
+    if (order.size() > 32767) {
+        std::fprintf(stderr, "Too many layer records (%zu, max 32767)\n", order.size());
+        return false;
+    }
+
+    QByteArray layerInfo;
+    QDataStream info(&layerInfo, QIODevice::WriteOnly);
+    QByteArray channelData;
+    Writer writer(info);
+    info << qint16(order.size());
+
+    const QByteArray emptyChannel(2, '\0');  // raw compression, no pixels
+    for (const auto& entry : order) {
+        const Node& node = nodes[entry.node];
+        QList<QPair<qint16, QByteArray>> channels;
+        if (node.group) {
+            for (qint16 id : { qint16(-1), qint16(0), qint16(1), qint16(2) })
+                channels.append({ id, emptyChannel });
+            // Mask and clipping belong to the folder record, not the divider
+            Node record = node;
+            if (entry.divider) {
+                record.clipped = false;
+                record.maskRect = QRect();
+            }
+            if (!record.maskRect.isEmpty()) {
+                const QRect& m = record.maskRect;
+                channels.append({ qint16(-2), encodeChannel(m.width(), m.height(), [&](int y, uchar* row) {
+                    fillEllipseRow(m, y, row);
+                }) });
+            }
+            writer.beginRecord(record, QRect(), channels);
+            writer.extraData(entry.divider ? Node() : node,
+                             entry.divider ? QStringLiteral("</Layer group>") : node.name,
+                             entry.divider ? 3 : 1,
+                             quint32(entry.divider ? nodes.size() + entry.node : entry.node));
+        } else {
+            const QRect& r = node.rect;
+            channels.append({ qint16(-1), encodeChannel(r.width(), r.height(), [&](int, uchar* row) {
+                for (int x = 0; x < r.width(); ++x)
+                    row[x] = !node.text.isEmpty() ? 0
+                        : node.translucent ? uchar(64 + 191 * x / std::max(1, r.width() - 1)) : 255;
+            }) });
+            for (int c = 0; c < 3; ++c) {
+                channels.append({ qint16(c), encodeChannel(r.width(), r.height(), [&](int, uchar* row) {
+                    std::fill(row, row + r.width(), node.color[c]);
+                }) });
+            }
+            if (!node.maskRect.isEmpty()) {
+                const QRect& m = node.maskRect;
+                channels.append({ qint16(-2), encodeChannel(m.width(), m.height(), [&](int y, uchar* row) {
+                    fillEllipseRow(m, y, row);
+                }) });
+            }
+            writer.beginRecord(node, r, channels);
+            writer.extraData(node, node.name, -1, quint32(entry.node));
+        }
+        for (const auto& channel : channels)
+            channelData.append(channel.second);
+    }
+    layerInfo.append(channelData);
+    if (layerInfo.size() % 2)
+        layerInfo.append('\0');
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        std::fprintf(stderr, "Cannot write %s\n", qPrintable(path));
+        return false;
+    }
+    QDataStream out(&file);
+
+    // Header: RGB, 8 bits, 3 merged channels
+    out.writeRawData("8BPS", 4);
+    out << quint16(1) << quint32(0) << quint16(0)
+        << quint16(3) << quint32(p.height) << quint32(p.width) << quint16(8) << quint16(3);
+    out << quint32(0);  // color mode data
+    out << quint32(0);  // image resources
+
+    // Layer and mask information
+    out << quint32(4 + layerInfo.size() + 4);
+    out << quint32(layerInfo.size());
+    out.writeRawData(layerInfo.constData(), layerInfo.size());
+    out << quint32(0);  // global layer mask info
+
+    // Merged image: flat white, RLE
+    QByteArray whiteRow;
+    QByteArray row(p.width, char(255));
+    packBits(reinterpret_cast<const uchar*>(row.constData()), p.width, whiteRow);
+    out << quint16(1);
+    for (int i = 0; i < 3 * p.height; ++i)
+        out << quint16(whiteRow.size());
+    for (int i = 0; i < 3 * p.height; ++i)
+        out.writeRawData(whiteRow.constData(), whiteRow.size());
+
+    return out.status() == QDataStream::Ok;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Generate synthetic PSD files"));
+    parser.addHelpOption();
+    const QCommandLineOption outputOption({ "o", "output" }, "Output file.", "file");
+    const QCommandLineOption presetOption("preset", "Use a named preset (see --list-presets).", "name");
+    const QCommandLineOption allPresetsOption("all-presets", "Write every preset into a directory.", "dir");
+    const QCommandLineOption listOption("list-presets", "List presets.");
+    const QCommandLineOption widthOption("width", "Canvas width.", "px");
+    const QCommandLineOption heightOption("height", "Canvas height.", "px");
+    const QCommandLineOption layersOption("layers", "Number of raster layers.", "n");
+    const QCommandLineOption groupsOption("groups", "Number of groups.", "n");
+    const QCommandLineOption depthOption("depth", "Maximum group nesting.", "n");
+    const QCommandLineOption maskOption("mask-ratio", "Fraction of layers with a mask.", "0..1");
+    const QCommandLineOption canvasMaskOption("canvas-masks", "Masks cover the whole canvas.");
+    const QCommandLineOption hiddenOption("hidden-ratio", "Fraction of hidden layers.", "0..1");
+    const QCommandLineOption translucentOption("translucent-ratio", "Fraction of layers with an alpha ramp.", "0..1");
+    const QCommandLineOption clipOption("clip-ratio", "Fraction of layers and groups clipped to the layer below.", "0..1");
+    const QCommandLineOption groupMaskOption("group-mask-ratio", "Fraction of groups with a mask.", "0..1");
+    const QCommandLineOption textOption("text-ratio", "Fraction of layers that are text layers.", "0..1");
+    const QCommandLineOption textRunsOption("text-runs", "Maximum style runs per text layer.", "n");
+    const QCommandLineOption blendOption("mixed-blend", "Use non-normal blend modes on some layers.");
+    const QCommandLineOption seedOption("seed", "Random seed.", "n");
+    parser.addOptions({ outputOption, presetOption, allPresetsOption, listOption,
+                        widthOption, heightOption, layersOption, groupsOption, depthOption,
+                        maskOption, canvasMaskOption, hiddenOption, translucentOption,
+                        clipOption, groupMaskOption, textOption, textRunsOption, blendOption, seedOption });
+    parser.process(app);
+
+    if (parser.isSet(listOption)) {
+        for (const auto& preset : presets())
+            std::printf("%-14s %s\n", preset.name, preset.description);
+        return 0;
+    }
+
+    if (parser.isSet(allPresetsOption)) {
+        const QDir dir(parser.value(allPresetsOption));
+        if (!QDir().mkpath(dir.path()))
+            return 1;
+        for (const auto& preset : presets()) {
+            const QString path = dir.filePath(QString::fromLatin1(preset.name) + ".psd");
+            if (!writePsd(path, preset.params))
+                return 1;
+            std::printf("%s\n", qPrintable(path));
+        }
+        return 0;
+    }
+
+    Params params;
+    if (parser.isSet(presetOption)) {
+        const QString name = parser.value(presetOption);
+        const auto it = std::find_if(presets().begin(), presets().end(),
+                                     [&](const Preset& p) { return name == QLatin1String(p.name); });
+        if (it == presets().end()) {
+            std::fprintf(stderr, "Unknown preset %s\n", qPrintable(name));
+            return 1;
+        }
+        params = it->params;
+    }
+    if (parser.isSet(widthOption)) params.width = parser.value(widthOption).toInt();
+    if (parser.isSet(heightOption)) params.height = parser.value(heightOption).toInt();
+    if (parser.isSet(layersOption)) params.layers = parser.value(layersOption).toInt();
+    if (parser.isSet(groupsOption)) params.groups = parser.value(groupsOption).toInt();
+    if (parser.isSet(depthOption)) params.depth = parser.value(depthOption).toInt();
+    if (parser.isSet(maskOption)) params.maskRatio = parser.value(maskOption).toDouble();
+    if (parser.isSet(canvasMaskOption)) params.canvasMasks = true;
+    if (parser.isSet(hiddenOption)) params.hiddenRatio = parser.value(hiddenOption).toDouble();
+    if (parser.isSet(translucentOption)) params.translucentRatio = parser.value(translucentOption).toDouble();
+    if (parser.isSet(clipOption)) params.clipRatio = parser.value(clipOption).toDouble();
+    if (parser.isSet(groupMaskOption)) params.groupMaskRatio = parser.value(groupMaskOption).toDouble();
+    if (parser.isSet(textOption)) params.textRatio = parser.value(textOption).toDouble();
+    if (parser.isSet(textRunsOption)) params.textRuns = parser.value(textRunsOption).toInt();
+    if (parser.isSet(blendOption)) params.mixedBlend = true;
+    if (parser.isSet(seedOption)) params.seed = parser.value(seedOption).toUInt();
+
+    if (!parser.isSet(outputOption)) {
+        std::fprintf(stderr, "No output file given (-o)\n");
+        return 1;
+    }
+    return writePsd(parser.value(outputOption), params) ? 0 : 1;
+}